@@ -7,6 +7,8 @@
 #include <algorithm>
 #include <numeric>
 #include <random>
+#include <cstdint>
+#include <cstring>
 
 #include "../../objectdb.hpp"
 
@@ -21,20 +23,23 @@ private:
     const std::vector<Object>& objects;
     Distance dist;
 
-    size_t l;          // global number of pivots
+    size_t l;          // pivots per object
     size_t cp_scale;   // PSA candidate pivot set size
+    size_t sample_q;   // sample queries used to score pivots per object
 
-    struct PivotEntry {
-        size_t pivot_id;   
-        dist_t distance;   // d(o, pivot_id)
-    };
-
-    std::vector<size_t> candidate_pivots;
-    std::vector<size_t> global_pivots;
-
+    // Pivotes de cada objeto: índice (1 byte) en candidate_pivots, de ahí
+    // el máximo de 256 candidatos.
+    using piv_t = uint8_t;
+    static constexpr size_t MAX_CANDIDATES = 256;
 
-    // table[oid][j] => distance(o, p[j])
-    std::vector<std::vector<PivotEntry>> table;
+    // Tabla plana de n filas x l columnas, con las filas ordenadas por la
+    // tupla de pivotes: los objetos con los mismos pivotes quedan contiguos
+    // y se recorren juntos reutilizando las distancias query → pivote.
+    std::vector<size_t>   candidate_pivots;
+    std::vector<uint32_t> row_oid;     // oid de cada fila
+    std::vector<piv_t>    row_piv;     // row_piv[i * l + j]: índice en candidate_pivots (ordenados)
+    std::vector<dist_t>   row_dist;    // row_dist[i * l + j] = d(row_oid[i], CP[row_piv[i * l + j]])
+    size_t n_groups = 0;               // tuplas de pivotes distintas
 
 
 public:
@@ -43,12 +48,14 @@ public:
         const std::vector<Object>& objs,
         Distance dist_fn,
         size_t l_pivots = 5,
-        size_t cp_scale_val = 40 // this value is set to 40, because of a previous work of Chen
+        size_t cp_scale_val = 40, // this value is set to 40, because of a previous work of Chen
+        size_t sample_q_val = 50
     )
         : objects(objs),
           dist(dist_fn),
           l(l_pivots),
-          cp_scale(cp_scale_val)
+          cp_scale(cp_scale_val),
+          sample_q(sample_q_val)
     {
         build();
     }
@@ -56,6 +63,10 @@ public:
     void build()
     {
         size_t n = objects.size();
+        row_oid.clear();
+        row_piv.clear();
+        row_dist.clear();
+        n_groups = 0;
         if (n == 0) return;
 
         
@@ -68,48 +79,130 @@ public:
         if (candidate_pivots.size() < l)
             l = candidate_pivots.size();
 
+        size_t cp = candidate_pivots.size();
+
+        // Distancias de una muestra de consultas a cada candidato
+        std::vector<size_t> Qs = sample_indices(std::min(n, sample_q));
+        std::vector<dist_t> q_cp(Qs.size() * cp);
+        for (size_t s = 0; s < Qs.size(); s++)
+            for (size_t c = 0; c < cp; c++)
+                q_cp[s * cp + c] = dist(objects[Qs[s]], objects[candidate_pivots[c]]);
+
+        // PSA paso 2, por objeto: greedy, cada pivote nuevo maximiza la media
+        // (sobre las consultas de muestra) de la mejor cota |d(q,p) - d(o,p)|.
+        // Se guarda primero en orden de oid.
+        std::vector<piv_t>  obj_piv(n * l);
+        std::vector<dist_t> obj_dist(n * l);
+        std::vector<dist_t> o_cp(cp);
+        std::vector<dist_t> best_lb(Qs.size());
+        std::vector<bool> chosen(cp);
+        std::vector<size_t> piv;
 
-        global_pivots = select_global_pivots_PSA(candidate_pivots);
+        for (size_t oid = 0; oid < n; oid++)
+        {
+            for (size_t c = 0; c < cp; c++)
+                o_cp[c] = dist(objects[oid], objects[candidate_pivots[c]]);
 
-        if (global_pivots.size() < l)
-            l = global_pivots.size();
+            std::fill(best_lb.begin(), best_lb.end(), 0.0);
+            std::fill(chosen.begin(), chosen.end(), false);
+            piv.clear();
 
+            while (piv.size() < l)
+            {
+                double best_score = -1.0;
+                size_t best_c = 0;
+                for (size_t c = 0; c < cp; c++) {
+                    if (chosen[c]) continue;
+                    double score = 0.0;
+                    for (size_t s = 0; s < Qs.size(); s++)
+                        score += std::max(best_lb[s], std::abs(q_cp[s * cp + c] - o_cp[c]));
+                    if (score > best_score) {
+                        best_score = score;
+                        best_c = c;
+                    }
+                }
+                chosen[best_c] = true;
+                piv.push_back(best_c);
+                for (size_t s = 0; s < Qs.size(); s++)
+                    best_lb[s] = std::max(best_lb[s], std::abs(q_cp[s * cp + best_c] - o_cp[best_c]));
+            }
 
-        // table for each object to the other pivots
-        table.assign(n, std::vector<PivotEntry>());
-        for (size_t oid = 0; oid < n; oid++)
-        {
-            table[oid].reserve(l);
+            std::sort(piv.begin(), piv.end());
             for (size_t j = 0; j < l; j++) {
-                size_t pid = global_pivots[j];
-                dist_t d = dist(objects[oid], objects[pid]);
-                table[oid].push_back({ pid, d });
+                obj_piv[oid * l + j]  = static_cast<piv_t>(piv[j]);
+                obj_dist[oid * l + j] = o_cp[piv[j]];
             }
         }
+
+        // Ordenar las filas por tupla de pivotes (lexicográfico, estable en oid)
+        std::vector<uint32_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return std::lexicographical_compare(
+                obj_piv.begin() + a * l, obj_piv.begin() + (a + 1) * l,
+                obj_piv.begin() + b * l, obj_piv.begin() + (b + 1) * l);
+        });
+
+        row_oid = order;
+        row_piv.resize(n * l);
+        row_dist.resize(n * l);
+        for (size_t i = 0; i < n; i++) {
+            std::copy_n(obj_piv.begin() + order[i] * l, l, row_piv.begin() + i * l);
+            std::copy_n(obj_dist.begin() + order[i] * l, l, row_dist.begin() + i * l);
+            if (i == 0 || !same_pivots(i, i - 1)) n_groups++;
+        }
     }
 
-    int rangeQuery(size_t qid, dist_t r) const
+    size_t num_groups() const { return n_groups; }
+
+    // Bytes de la tabla por objeto (oid + l índices + l distancias)
+    size_t bytes_per_object() const { return sizeof(uint32_t) + l * (sizeof(piv_t) + sizeof(dist_t)); }
+
+    // Resultado de una consulta. Los objetos validados por Lemma 4 no calculan
+    // d(q,o): dist es entonces la cota superior min_j d(q,p_j) + d(o,p_j) <= r.
+    struct Hit {
+        size_t id;
+        dist_t dist;
+        bool exact;   // false si fue validado por Lemma 4
+    };
+
+    // Memoria de trabajo reutilizable: con el mismo Scratch, las consultas
+    // siguientes no reservan memoria.
+    struct Scratch {
+        std::vector<dist_t> q_dists;                   // d(q, CP[c]), -1 si aún no calculada
+        std::vector<dist_t> gq;                        // distancias del grupo actual
+        std::vector<std::pair<dist_t,size_t>> cand;    // kNN: (cota inferior, oid)
+        std::vector<std::pair<dist_t,size_t>> heap;    // kNN: max-heap de resultados
+    };
+
+    // Rango con visitante: visit(const Hit&) se llama con cada resultado en cuanto
+    // se valida. Devuelve el número de resultados.
+    template<typename Visitor>
+    int rangeVisit(size_t qid, dist_t r, Visitor&& visit, Scratch& sc) const
     {
+        if (objects.empty() || l == 0 || row_oid.empty()) return 0;
         const Object& q = objects[qid];
-        size_t n = objects.size();
-        if (n == 0 || l == 0 || table.empty()) return 0;
 
-        // Distancias query → pivotes GLOBALes (mismos para todos los objetos)
-        std::vector<dist_t> q_dists(l);
-        for (size_t i = 0; i < l; i++) {
-            size_t pid = table[0][i].pivot_id;       // pivot i-ésimo global
-            q_dists[i] = dist(q, objects[pid]);
-        }
+        // Distancias query → candidatos, calculadas sólo cuando alguna fila las usa
+        sc.q_dists.assign(candidate_pivots.size(), -1.0);
+        sc.gq.resize(l);
+        std::vector<dist_t>& q_dists = sc.q_dists;
+        std::vector<dist_t>& gq = sc.gq;
 
         int count = 0;
 
-        for (size_t oid = 0; oid < n; oid++)
+        for (size_t i = 0; i < row_oid.size(); i++)
         {
+            // gq sólo cambia al empezar un grupo (tupla de pivotes nueva)
+            if (i == 0 || !same_pivots(i, i - 1))
+                load_query_dists(q, i, q_dists, gq);
+
+            const dist_t* row = row_dist.data() + i * l;
+
             // LEMMA 1 — pivot filtering
             bool prune = false;
             for (size_t j = 0; j < l; j++) {
-                // table[oid][j].distance = d(o, p_j global)
-                if (std::abs(q_dists[j] - table[oid][j].distance) > r) {
+                if (std::abs(gq[j] - row[j]) > r) {
                     prune = true;
                     break;
                 }
@@ -117,54 +210,85 @@ public:
             if (prune) continue;
 
             // LEMMA 4 — pivot validation
-            bool valid = false;
-            for (size_t j = 0; j < l; j++) {
-                if (table[oid][j].distance <= r - q_dists[j]) {
-                    valid = true;
-                    break;
-                }
-            }
-            if (valid) {
+            dist_t upper = std::numeric_limits<dist_t>::infinity();
+            for (size_t j = 0; j < l; j++)
+                upper = std::min(upper, row[j] + gq[j]);
+            if (upper <= r) {
                 count++;
+                visit(Hit{ row_oid[i], upper, false });
                 continue;
             }
 
-            if (dist(q, objects[oid]) <= r)
+            dist_t d = dist(q, objects[row_oid[i]]);
+            if (d <= r) {
                 count++;
+                visit(Hit{ row_oid[i], d, true });
+            }
         }
 
         return count;
     }
 
-    dist_t knnQuery(size_t qid, size_t k) const
+    int rangeQuery(size_t qid, dist_t r) const
     {
-        std::vector<std::pair<dist_t,size_t>> heap; // max-heap simulado
-        heap.reserve(k);
+        Scratch sc;
+        return rangeVisit(qid, r, [](const Hit&) {}, sc);
+    }
 
+    // Agrega los resultados a out (el llamador puede reutilizar el vector)
+    int rangeQuery(size_t qid, dist_t r, std::vector<Hit>& out) const
+    {
+        Scratch sc;
+        return rangeVisit(qid, r, [&](const Hit& h) { out.push_back(h); }, sc);
+    }
+
+    // Escribe hasta capacity resultados en out; devuelve el total encontrado
+    int rangeQuery(size_t qid, dist_t r, Hit* out, size_t capacity, Scratch& sc) const
+    {
+        size_t written = 0;
+        return rangeVisit(qid, r, [&](const Hit& h) {
+            if (written < capacity) out[written++] = h;
+        }, sc);
+    }
+
+    // kNN: escribe en out (capacidad >= k) los vecinos en orden creciente de
+    // distancia, todos exactos; devuelve cuántos escribió.
+    size_t knnQuery(size_t qid, size_t k, Hit* out, Scratch& sc) const
+    {
+        std::vector<std::pair<dist_t,size_t>>& heap = sc.heap; // max-heap simulado
+        heap.clear();
+
+        if (objects.empty() || l == 0 || row_oid.empty() || k == 0) return 0;
         const Object& q = objects[qid];
-        size_t n = objects.size();
-        if (n == 0 || l == 0 || table.empty() || k == 0) return 0.0;
 
-        // Precompute q->pivots 
-        std::vector<dist_t> q_dists(l);
-        for (size_t i = 0; i < l; i++) {
-            size_t pid = table[0][i].pivot_id;
-            q_dists[i] = dist(q, objects[pid]);
+        sc.q_dists.assign(candidate_pivots.size(), -1.0);
+        sc.gq.resize(l);
+        std::vector<dist_t>& q_dists = sc.q_dists;
+        std::vector<dist_t>& gq = sc.gq;
+
+        // Cota inferior (Lemma 1) de cada objeto con sus propios pivotes
+        std::vector<std::pair<dist_t,size_t>>& cand = sc.cand;
+        cand.clear();
+
+        for (size_t i = 0; i < row_oid.size(); i++)
+        {
+            if (i == 0 || !same_pivots(i, i - 1))
+                load_query_dists(q, i, q_dists, gq);
+
+            const dist_t* row = row_dist.data() + i * l;
+            dist_t lb = 0.0;
+            for (size_t j = 0; j < l; j++)
+                lb = std::max(lb, std::abs(gq[j] - row[j]));
+            cand.emplace_back(lb, row_oid[i]);
         }
 
+        // Verificar en orden de cota creciente; se corta cuando la cota alcanza el radio actual
+        std::sort(cand.begin(), cand.end());
         dist_t r = std::numeric_limits<dist_t>::infinity();
 
-        for (size_t oid = 0; oid < n; oid++)
+        for (auto& [lb, oid] : cand)
         {
-            // Lemma 1 (con radio actual r)
-            bool prune = false;
-            for (size_t j = 0; j < l; j++) {
-                if (std::abs(q_dists[j] - table[oid][j].distance) > r) {
-                    prune = true;
-                    break;
-                }
-            }
-            if (prune) continue;
+            if (lb >= r) break;
 
             dist_t d = dist(q, objects[oid]);
 
@@ -185,12 +309,40 @@ public:
             }
         }
 
-        return (heap.size() == k) ? heap.front().first : 0.0;
+        std::sort(heap.begin(), heap.end());
+        for (size_t i = 0; i < heap.size(); i++)
+            out[i] = Hit{ heap[i].second, heap[i].first, true };
+        return heap.size();
+    }
+
+    // Devuelve sólo la distancia al k-ésimo vecino (0 si hay menos de k objetos)
+    dist_t knnQuery(size_t qid, size_t k) const
+    {
+        Scratch sc;
+        std::vector<Hit> out(k);
+        size_t found = knnQuery(qid, k, out.data(), sc);
+        return (found == k) ? out[k - 1].dist : 0.0;
     }
 
 
 private:
 
+    bool same_pivots(size_t a, size_t b) const
+    {
+        return std::memcmp(row_piv.data() + a * l, row_piv.data() + b * l, l * sizeof(piv_t)) == 0;
+    }
+
+    // gq[j] = d(q, pivote j de la fila i); cada d(q, CP[c]) se calcula una sola vez
+    void load_query_dists(const Object& q, size_t i, std::vector<dist_t>& q_dists, std::vector<dist_t>& gq) const
+    {
+        for (size_t j = 0; j < l; j++) {
+            piv_t c = row_piv[i * l + j];
+            dist_t& qd = q_dists[c];
+            if (qd < 0) qd = dist(q, objects[candidate_pivots[c]]);
+            gq[j] = qd;
+        }
+    }
+
     std::vector<size_t> HF_candidates(const std::vector<size_t>& S)
     {
         size_t s = S.size();
@@ -210,7 +362,7 @@ private:
         std::sort(idx.begin(), idx.end(),
             [&](size_t a, size_t b){ return ecc[a] > ecc[b]; });
 
-        size_t take = std::min(cp_scale, s);
+        size_t take = std::min({cp_scale, s, MAX_CANDIDATES});
         std::vector<size_t> CP;
         CP.reserve(take);
         for (size_t i = 0; i < take; i++)
@@ -219,74 +371,6 @@ private:
         return CP; // candidate pivots
     }
 
-    
-    // PSA: greedy selection of l pivots
-    //  - Primer pivot: el de mayor excentricidad (media de distancias a CP).
-    //  - Siguientes: farthest-first, maximizando la distancia mínima a pivotes ya elegidos.
-    // -------------------------------------------------------------------------
-    std::vector<size_t> select_global_pivots_PSA(const std::vector<size_t>& CP)
-    {
-        std::vector<size_t> P;
-        if (CP.empty() || l == 0) return P;
-
-        size_t s = CP.size();
-
-        // Recalcular excentricidades dentro de CP (podríamos reutilizar, pero es barato)
-        std::vector<double> ecc(s, 0.0);
-        for (size_t i = 0; i < s; i++) {
-            double sum = 0.0;
-            for (size_t j = 0; j < s; j++) {
-                sum += dist(objects[CP[i]], objects[CP[j]]);
-            }
-            ecc[i] = sum / static_cast<double>(s);
-        }
-
-        // 1) Primer pivot: el de máxima excentricidad
-        size_t best_idx = 0;
-        double best_val = ecc[0];
-        for (size_t i = 1; i < s; i++) {
-            if (ecc[i] > best_val) {
-                best_val = ecc[i];
-                best_idx = i;
-            }
-        }
-        P.push_back(CP[best_idx]);
-
-        // Marcar usados
-        std::vector<bool> used(s,false);
-        used[best_idx] = true;
-
-        // 2) Siguientes pivotes: greedy farthest-first
-        while (P.size() < l)
-        {
-            double best_score = -1.0;
-            size_t best_cand  = 0;
-            bool found = false;
-
-            for (size_t i = 0; i < s; i++) {
-                if (used[i]) continue;
-
-                // Distancia mínima de CP[i] a los pivotes ya elegidos
-                double min_d = std::numeric_limits<double>::infinity();
-                for (size_t pj : P) {
-                    double d = dist(objects[CP[i]], objects[pj]);
-                    if (d < min_d) min_d = d;
-                }
-
-                if (min_d > best_score) {
-                    best_score = min_d;
-                    best_cand  = i;
-                    found = true;
-                }
-            }
-
-            if (!found) break; // no quedan candidatos útiles
-            used[best_cand] = true;
-            P.push_back(CP[best_cand]);
-        }
-
-        return P;
-    }
 
     // Muestra aleatoria de índices
     std::vector<size_t> sample_indices(size_t k)
@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <cmath>
 #include <memory>
+#include <cstdint>
 
 class FQT {
 private:
@@ -34,6 +35,14 @@ private:
     bool use_external_pivots = false;
     std::unique_ptr<FQTNode> root;
 
+    // Modo FQA (Fixed-Queries Array): sin árbol, un arreglo plano ordenado
+    // lexicográficamente por la firma discretizada (bin por pivote) de cada objeto.
+    bool use_fqa = false;
+    std::vector<int> fqa_ids;            // objetos en orden de firma
+    std::vector<uint8_t> fqa_codes;      // bin del objeto por nivel, por columnas: fqa_codes[level * n + pos]
+    std::vector<double> fqa_bin_lo;      // distancia mínima real en el bin: fqa_bin_lo[level * arity + b]
+    std::vector<double> fqa_bin_hi;      // distancia máxima real en el bin (lo > hi si el bin está vacío)
+
     std::unique_ptr<FQTNode> buildRecursive(std::vector<int>& objects, int depth) {
         auto node = std::make_unique<FQTNode>();
         
@@ -214,14 +223,145 @@ private:
         }
     }
 
+    // ---------------- FQA ----------------
+
+    void buildFQA(const std::vector<int>& objects) {
+        int n = (int)objects.size();
+
+        // Índice vacío: con pivotes externos, todos los bins quedan vacíos
+        // y las consultas no visitan nada
+        if (n == 0) {
+            fqa_bin_lo.assign((size_t)height * arity, std::numeric_limits<double>::infinity());
+            fqa_bin_hi.assign((size_t)height * arity, -std::numeric_limits<double>::infinity());
+            return;
+        }
+
+        // Sin pivotes externos: los suficientes para que un rango típico quede en ~bucket_size objetos
+        if (!use_external_pivots) {
+            double levels = std::log(std::max(1.0, (double)n / std::max(1, bucket_size))) / std::log((double)arity);
+            height = std::max(1, (int)std::ceil(levels));
+            for (int i = 0; i < height; i++) pivots.push_back(objects[rand() % n]);
+        }
+
+        // Firma de cada objeto: bin uniforme en [min, max] de las distancias a cada pivote
+        std::vector<uint8_t> sig((size_t)n * height);   // por filas, sólo durante la construcción
+        fqa_bin_lo.assign((size_t)height * arity, std::numeric_limits<double>::infinity());
+        fqa_bin_hi.assign((size_t)height * arity, -std::numeric_limits<double>::infinity());
+        std::vector<double> dists(n);
+        for (int level = 0; level < height; level++) {
+            for (int j = 0; j < n; j++) {
+                dists[j] = db->distance(pivots[level], objects[j]);
+                compdists++;
+            }
+            double min_d = *std::min_element(dists.begin(), dists.end());
+            double max_d = *std::max_element(dists.begin(), dists.end());
+            double step = (max_d - min_d) / arity;
+            if (step < 1e-9) step = 1.0;  // evitar división por 0
+
+            for (int j = 0; j < n; j++) {
+                int b = std::min((int)((dists[j] - min_d) / step), arity - 1);
+                sig[(size_t)j * height + level] = (uint8_t)b;
+                double& lo = fqa_bin_lo[level * arity + b];
+                double& hi = fqa_bin_hi[level * arity + b];
+                lo = std::min(lo, dists[j]);
+                hi = std::max(hi, dists[j]);
+            }
+        }
+
+        // Orden lexicográfico por firma
+        std::vector<int> order(n);
+        for (int j = 0; j < n; j++) order[j] = j;
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return std::lexicographical_compare(sig.begin() + (size_t)a * height, sig.begin() + (size_t)(a + 1) * height,
+                                                sig.begin() + (size_t)b * height, sig.begin() + (size_t)(b + 1) * height);
+        });
+
+        fqa_ids.resize(n);
+        fqa_codes.resize((size_t)n * height);
+        for (int pos = 0; pos < n; pos++) {
+            fqa_ids[pos] = objects[order[pos]];
+            for (int level = 0; level < height; level++)
+                fqa_codes[(size_t)level * n + pos] = sig[(size_t)order[pos] * height + level];
+        }
+    }
+
+    // Subrango [lo, hi) cuyo código en 'level' es b (dentro de [lo, hi) los códigos de ese nivel están ordenados)
+    std::pair<int, int> fqaNarrow(int level, int lo, int hi, int b) const {
+        const uint8_t* col = fqa_codes.data() + (size_t)level * fqa_ids.size();
+        auto r = std::equal_range(col + lo, col + hi, (uint8_t)b);
+        return {(int)(r.first - col), (int)(r.second - col)};
+    }
+
+    // Distancia mínima posible entre d(q,p_level) y los objetos del bin b (infinito si está vacío)
+    double fqaBinGap(int level, int b, double d_pivot) const {
+        double lo = fqa_bin_lo[level * arity + b];
+        double hi = fqa_bin_hi[level * arity + b];
+        if (lo > hi) return std::numeric_limits<double>::infinity();
+        return std::max({0.0, lo - d_pivot, d_pivot - hi});
+    }
+
+    int rangeFQA(int level, int lo, int hi, int query, double radius, const std::vector<double>& pivot_dists) {
+        if (level == height) {
+            int count = 0;
+            for (int pos = lo; pos < hi; pos++) {
+                double d = db->distance(query, fqa_ids[pos]);
+                compdists++;
+                if (d <= radius) count++;
+            }
+            return count;
+        }
+
+        int count = 0;
+        for (int b = 0; b < arity; b++) {
+            if (fqaBinGap(level, b, pivot_dists[level]) > radius) continue; // LEMMA 4.1
+            auto [sub_lo, sub_hi] = fqaNarrow(level, lo, hi, b);
+            if (sub_lo < sub_hi)
+                count += rangeFQA(level + 1, sub_lo, sub_hi, query, radius, pivot_dists);
+        }
+        return count;
+    }
+
+    void knnFQA(int level, int lo, int hi, double lower_bound, int query, int k,
+                const std::vector<double>& pivot_dists, std::priority_queue<std::pair<double, int>>& best) {
+        if (level == height) {
+            for (int pos = lo; pos < hi; pos++) {
+                double d = db->distance(query, fqa_ids[pos]);
+                compdists++;
+                if ((int)best.size() < k) best.push({d, fqa_ids[pos]});
+                else if (d < best.top().first) { best.pop(); best.push({d, fqa_ids[pos]}); }
+            }
+            return;
+        }
+
+        // Bins más cercanos primero, para reducir el radio de búsqueda cuanto antes
+        std::vector<std::pair<double, int>> bins;
+        for (int b = 0; b < arity; b++) {
+            double gap = fqaBinGap(level, b, pivot_dists[level]);
+            if (gap != std::numeric_limits<double>::infinity())
+                bins.push_back({std::max(lower_bound, gap), b});
+        }
+        std::sort(bins.begin(), bins.end());
+
+        for (auto& [lb, b] : bins) {
+            if ((int)best.size() >= k && lb > best.top().first) break;
+            auto [sub_lo, sub_hi] = fqaNarrow(level, lo, hi, b);
+            if (sub_lo < sub_hi)
+                knnFQA(level + 1, sub_lo, sub_hi, lb, query, k, pivot_dists, best);
+        }
+    }
+
 public:
-    FQT(ObjectDB* database, int bucket_sz, int ar, const std::vector<int>& pivots_list = {})
-        : db(database), bucket_size(bucket_sz), arity(ar), height(0), compdists(0)
+    FQT(ObjectDB* database, int bucket_sz, int ar, const std::vector<int>& pivots_list = {}, bool fqa_mode = false)
+        : db(database), bucket_size(bucket_sz), arity(ar), height(0), compdists(0), use_fqa(fqa_mode)
     {
         if (!pivots_list.empty()) {
             external_pivots = pivots_list;
             use_external_pivots = true;
         }
+        if (use_fqa && arity > 256) {
+            std::cerr << "[FQT] Warning: FQA codes are 8-bit, arity clamped to 256\n";
+            arity = 256;
+        }
     }
 
     void build() {
@@ -240,6 +380,11 @@ public:
             all_objects.push_back(i);
         }
         
+        if (use_fqa) {
+            buildFQA(all_objects);
+            return;
+        }
+
         // Construir árbol
         root = buildRecursive(all_objects, 0);
     }
@@ -248,19 +393,35 @@ public:
         long long old_compdists = compdists;
         
         // Contar distancias a pivotes
+        std::vector<double> pivot_dists;
         for (int pivot : pivots) {
             double d = db->distance(query, pivot);
             compdists++;
+            pivot_dists.push_back(d);
             if (d <= radius) {
                 // El pivote es resultado pero no lo contamos aquí 
             }
         }
+
+        if (use_fqa)
+            return rangeFQA(0, 0, (int)fqa_ids.size(), query, radius, pivot_dists);
         
         int count = rangeRecursive(root.get(), query, radius, 0);
         return count;
     }
 
     double knn(int query, int k) {
+        if (use_fqa) {
+            std::vector<double> pivot_dists(height);
+            for (int i = 0; i < height; i++) {
+                pivot_dists[i] = db->distance(query, pivots[i]);
+                compdists++;
+            }
+            std::priority_queue<std::pair<double, int>> best;
+            knnFQA(0, 0, (int)fqa_ids.size(), 0.0, query, k, pivot_dists, best);
+            return best.empty() ? 0.0 : best.top().first;  // k-ésima distancia
+        }
+
         std::vector<std::pair<double, int>> results;
         knnRecursive(query, k, results);
         
@@ -269,6 +430,12 @@ public:
     }
 
     int getHeight() const { return height; }
+    bool isFQA() const { return use_fqa; }
+    // Memoria del índice FQA (ids + códigos + tablas de bins)
+    size_t fqaBytes() const {
+        return fqa_ids.size() * sizeof(int) + fqa_codes.size()
+             + (fqa_bin_lo.size() + fqa_bin_hi.size()) * sizeof(double);
+    }
     long long getCompdists() const { return compdists; }
     void resetCompdists() { compdists = 0; }
 };
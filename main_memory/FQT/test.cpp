@@ -13,6 +13,9 @@ static const vector<double> SELECTIVITIES = {0.02, 0.04, 0.08, 0.16, 0.32};
 static const vector<int>    K_VALUES      = {5, 10, 20, 50, 100};
 static const vector<int>    L_VALUES      = {3, 5, 10, 15, 20};
 
+// true = FQA (arreglo plano ordenado por firma) en lugar del árbol FQT
+static const bool USE_FQA = false;
+
 // static const vector<string> DATASETS = {"LA","Words","Color","Synthetic"};
 static const vector<string> DATASETS = {"LA"};
 
@@ -161,13 +164,15 @@ int main(int argc, char** argv)
 
             // Construir FQT
             auto t0 = chrono::high_resolution_clock::now();
-            FQT index(db.get(), P.bucket, P.arity, pivots);
+            FQT index(db.get(), P.bucket, P.arity, pivots, USE_FQA);
             index.build();
             auto t1 = chrono::high_resolution_clock::now();
 
             double build_ms = chrono::duration_cast<chrono::milliseconds>(t1 - t0).count();
 
-            cout << "[BUILD] time_ms=" << build_ms << " height=" << l << "\n";
+            cout << "[BUILD] time_ms=" << build_ms << " height=" << l;
+            if (USE_FQA) cout << " fqa_bytes=" << index.fqaBytes();
+            cout << "\n";
 
             // ========================
             // MRQ EXPERIMENTS
@@ -196,7 +201,7 @@ int main(int argc, char** argv)
 
                 J << fixed << setprecision(6);
                 J << "{"
-                  << "\"index\":\"FQT\","
+                  << "\"index\":\"" << (USE_FQA ? "FQA" : "FQT") << "\","
                   << "\"dataset\":\"" << dataset << "\","
                   << "\"num_pivots\":" << l << ","
                   << "\"arity\":" << P.arity << ","
@@ -237,7 +242,7 @@ int main(int argc, char** argv)
 
                 J << fixed << setprecision(6);
                 J << "{"
-                  << "\"index\":\"FQT\","
+                  << "\"index\":\"" << (USE_FQA ? "FQA" : "FQT") << "\","
                   << "\"dataset\":\"" << dataset << "\","
                   << "\"num_pivots\":" << l << ","
                   << "\"arity\":" << P.arity << ","
@@ -9,17 +9,30 @@ using namespace std;
 
 extern int MaxHeight;
 
+// Nodo en arena: los hijos de un nodo interno ocupan posiciones consecutivas de
+// GNAT_t::nodes, y pivotes, buckets y tabla de rangos viven en arreglos planos.
 struct GNAT_node_t {
-    vector<int> pivot;                
-    vector<GNAT_node_t> children;     
-    vector<vector<double>> min_dist, max_dist; // [i][j]: min/max dist pivote i -> subárbol j
-    vector<int> bucket; 
-    int num = 0; // number of objects inside the bucket
+    int num = 0;               // -1 si es interno; si es hoja, número de objetos del bucket
+    uint32_t pivot_begin = 0;  // pivots[pivot_begin .. pivot_begin + pivot_cnt)
+    uint32_t pivot_cnt = 0;
+    uint32_t child_begin = 0;  // nodes[child_begin + i] = subárbol del pivote i
+    uint32_t child_cnt = 0;    // 0 o pivot_cnt
+    uint32_t range_begin = 0;  // ranges[range_begin + 2*(j*pivot_cnt + i)] = {min, max} dist pivote j -> subárbol i
+    uint32_t bucket_begin = 0; // bucket[bucket_begin .. bucket_begin + num)
+};
+
+struct GNAT_result_t {
+    int id;
+    double dist;
+    bool operator<(const GNAT_result_t& o) const { return dist < o.dist; }
 };
 
 class GNAT_t {
     const ObjectDB* db;           
-    GNAT_node_t root;             
+    vector<GNAT_node_t> nodes;    // nodes[0] es la raíz
+    vector<int> pivots;
+    vector<int> bucket;
+    vector<float> ranges;         // tablas m×m por nodo, {min,max} redondeados hacia afuera
 
     size_t max_pivot_cnt;
     size_t min_pivot_cnt;
@@ -33,23 +46,46 @@ class GNAT_t {
         return db->distance(x, y);
     }
 
-    void select(size_t& pivot_cnt, vector<int>& objects, GNAT_node_t* root);
-    void _build(GNAT_node_t* root, vector<int> objects, size_t pivot_size, int h);
-    void _rangeSearch(const GNAT_node_t* root, int query, double range, int& res_size);
-    void _knnSearch(const GNAT_node_t* root, int query, int k,
-                    priority_queue<double>& result, double& ave_r);
+    void select(size_t& pivot_cnt, vector<int>& objects, vector<int>& node_pivots);
+    void _build(size_t node, vector<int> objects, size_t pivot_size, int h);
+    void _rangeSearch(const GNAT_node_t& node, int query, double range, vector<GNAT_result_t>& result);
+    void _knnSearch(const GNAT_node_t& node, int query, int k,
+                    priority_queue<GNAT_result_t>& result);
 
 public:
     GNAT_t(const ObjectDB* db, size_t avg_pivot_cnt);
 
     void build();
+
+    // Consultas: devuelven los ids y distancias encontrados (kNN ordenado por distancia)
+    void rangeSearch(int query, double range, vector<GNAT_result_t>& result);
+    void knnSearch(int query, int k, vector<GNAT_result_t>& result);
+
+    // Versiones por lote usadas por los benchmarks
     void rangeSearch(const vector<int>& queries, double range, int& result_size);
     void knnSearch(const vector<int>& queries, int k, double& ave_r);
 
     long long get_compDist() const { return dist_call_cnt; }
     void reset_compDist() { dist_call_cnt = 0; }
+    size_t memoryBytes() const {
+        return nodes.size() * sizeof(GNAT_node_t) + (pivots.size() + bucket.size()) * sizeof(int)
+             + ranges.size() * sizeof(float);
+    }
 };
 
+// float más cercano que no supera / no es menor que x (cotas conservadoras)
+static inline float floor_to_float(double x) {
+    float f = (float)x;
+    if ((double)f > x) f = nextafterf(f, -numeric_limits<float>::infinity());
+    return f;
+}
+
+static inline float ceil_to_float(double x) {
+    float f = (float)x;
+    if ((double)f < x) f = nextafterf(f, numeric_limits<float>::infinity());
+    return f;
+}
+
 
 GNAT_t::GNAT_t(const ObjectDB* db_, size_t avg_pivot_cnt_)
     : db(db_),
@@ -69,10 +105,14 @@ void GNAT_t::build() {
     std::shuffle(objects.begin(), objects.end(), rng);
 
     cout << "database size: " << objects.size() << endl;
-    _build(&root, objects, avg_pivot_cnt, 1);
+    nodes.assign(1, GNAT_node_t());
+    pivots.clear();
+    bucket.clear();
+    ranges.clear();
+    _build(0, objects, avg_pivot_cnt, 1);
 }
 
-void GNAT_t::select(size_t& pivot_cnt, vector<int>& objects, GNAT_node_t* root) {
+void GNAT_t::select(size_t& pivot_cnt, vector<int>& objects, vector<int>& node_pivots) {
     size_t sample_cnt = min(pivot_cnt * 3, objects.size());
     vector<int> sample(sample_cnt);
     copy(objects.end() - sample_cnt, objects.end(), sample.begin());
@@ -120,7 +160,7 @@ void GNAT_t::select(size_t& pivot_cnt, vector<int>& objects, GNAT_node_t* root)
     }
 
     for (auto i : pivot_pos) {
-        root->pivot.push_back(sample[i]);
+        node_pivots.push_back(sample[i]);
     }
     for (size_t i = 0; i < sample_cnt; ++i) {
         if (!is_pivot[i]) {
@@ -129,25 +169,23 @@ void GNAT_t::select(size_t& pivot_cnt, vector<int>& objects, GNAT_node_t* root)
     }
 }
 
-void GNAT_t::_build(GNAT_node_t* root, vector<int> objects, size_t pivot_cnt, int h) {
+void GNAT_t::_build(size_t node, vector<int> objects, size_t pivot_cnt, int h) {
     if (objects.empty()) {
         return;
     }
 
     if (h < MaxHeight) {
-        root->num = -1;
-        auto& pivot    = root->pivot;
-        auto& children = root->children;
-        auto& max_dist = root->max_dist;
-        auto& min_dist = root->min_dist;
+        nodes[node].num = -1;
 
-        min_dist.resize(pivot_cnt, vector<double>(pivot_cnt, DBL_MAX));
-        max_dist.resize(pivot_cnt, vector<double>(pivot_cnt, 0.0));
-        select(pivot_cnt, objects, root);
+        vector<int> pivot;
+        select(pivot_cnt, objects, pivot);
+        nodes[node].pivot_begin = (uint32_t)pivots.size();
+        nodes[node].pivot_cnt   = (uint32_t)pivot_cnt;
+        pivots.insert(pivots.end(), pivot.begin(), pivot.end());
 
-        if (objects.empty()) {
-            return;
-        }
+        // La tabla se acumula en double y se guarda en float al final
+        vector<double> min_dist(pivot_cnt * pivot_cnt, DBL_MAX);
+        vector<double> max_dist(pivot_cnt * pivot_cnt, 0.0);
 
         vector<vector<int>> objs_children(pivot_cnt);
         for (int obj : objects) {
@@ -159,12 +197,29 @@ void GNAT_t::_build(GNAT_node_t* root, vector<int> objects, size_t pivot_cnt, in
                 min_element(dist_pivot.begin(), dist_pivot.end()) - dist_pivot.begin();
             objs_children[closest_pivot].push_back(obj);
             for (size_t i = 0; i < pivot_cnt; ++i) {
-                max_dist[i][closest_pivot] = max(max_dist[i][closest_pivot], dist_pivot[i]);
-                min_dist[i][closest_pivot] = min(min_dist[i][closest_pivot], dist_pivot[i]);
+                size_t cell = i * pivot_cnt + closest_pivot;
+                max_dist[cell] = max(max_dist[cell], dist_pivot[i]);
+                min_dist[cell] = min(min_dist[cell], dist_pivot[i]);
             }
         }
 
-        children.resize(pivot_cnt);
+        nodes[node].range_begin = (uint32_t)ranges.size();
+        for (size_t cell = 0; cell < pivot_cnt * pivot_cnt; ++cell) {
+            ranges.push_back(min_dist[cell] == DBL_MAX ? numeric_limits<float>::infinity()
+                                                       : floor_to_float(min_dist[cell]));
+            ranges.push_back(ceil_to_float(max_dist[cell]));
+        }
+
+        if (objects.empty()) {
+            return;
+        }
+
+        // Los hijos se reservan juntos para que queden contiguos en la arena
+        size_t child_begin = nodes.size();
+        nodes[node].child_begin = (uint32_t)child_begin;
+        nodes[node].child_cnt   = (uint32_t)pivot_cnt;
+        nodes.resize(child_begin + pivot_cnt);
+
         for (size_t i = 0; i < pivot_cnt; ++i) {
             size_t next_pivot_cnt =
                 objs_children[i].empty()
@@ -172,108 +227,122 @@ void GNAT_t::_build(GNAT_node_t* root, vector<int> objects, size_t pivot_cnt, in
                     : objs_children[i].size() * avg_pivot_cnt * pivot_cnt / objects.size();
             next_pivot_cnt = max(min_pivot_cnt, next_pivot_cnt);
             next_pivot_cnt = min(max_pivot_cnt, next_pivot_cnt);
-            _build(&children[i],
+            _build(child_begin + i,
                    objs_children[i],
                    min(next_pivot_cnt, objs_children[i].size()),
                    h + 1);
         }
     } else {
-        root->num = (int)objects.size();
-        root->bucket.assign(objects.begin(), objects.end());
+        nodes[node].num = (int)objects.size();
+        nodes[node].bucket_begin = (uint32_t)bucket.size();
+        bucket.insert(bucket.end(), objects.begin(), objects.end());
     }
 }
 
-void GNAT_t::_rangeSearch(const GNAT_node_t* root, int query, double range, int& res_size) {
-    if (root->num < 0) {
-        auto& pivot    = root->pivot;
-        auto& children = root->children;
-        auto& max_dist = root->max_dist;
-        auto& min_dist = root->min_dist;
-        size_t n = pivot.size();
+void GNAT_t::_rangeSearch(const GNAT_node_t& node, int query, double range, vector<GNAT_result_t>& result) {
+    if (node.num < 0) {
+        const int* pivot   = pivots.data() + node.pivot_begin;
+        const float* table = ranges.data() + node.range_begin;
+        size_t n = node.pivot_cnt;
 
         vector<double> d(n);
         for (size_t i = 0; i < n; ++i) {
             d[i] = dist(pivot[i], query);
             if (d[i] <= range) {
-                ++res_size;
+                result.push_back({pivot[i], d[i]});
             }
         }
 
-        for (size_t i = 0; i < n; ++i) {
+        for (size_t i = 0; i < node.child_cnt; ++i) {
             bool ok = true;
             for (size_t j = 0; ok && j < n; ++j) {
-                ok &= (max_dist[j][i] >= d[j] - range);
-                ok &= (min_dist[j][i] <= d[j] + range);
+                const float* cell = table + 2 * (j * n + i);
+                ok &= (cell[1] >= d[j] - range);
+                ok &= (cell[0] <= d[j] + range);
             }
             if (ok) {
-                _rangeSearch(&children[i], query, range, res_size);
+                _rangeSearch(nodes[node.child_begin + i], query, range, result);
             }
         }
     } else {
-        for (int id : root->bucket) {
+        for (int b = 0; b < node.num; ++b) {
+            int id = bucket[node.bucket_begin + b];
             double d = dist(query, id);
-            if (d <= range) ++res_size;
+            if (d <= range) result.push_back({id, d});
         }
     }
 }
 
+void GNAT_t::rangeSearch(int query, double range, vector<GNAT_result_t>& result) {
+    if (!nodes.empty()) _rangeSearch(nodes[0], query, range, result);
+}
+
 void GNAT_t::rangeSearch(const vector<int>& queries, double range, int& res_size) {
+    vector<GNAT_result_t> result;
     for (int q : queries) {
-        _rangeSearch(&root, q, range, res_size);
+        result.clear();
+        rangeSearch(q, range, result);
+        res_size += (int)result.size();
     }
 }
 
-static void addResult(int k, double d,
-                      priority_queue<double>& result, double& r) {
-    if ((int)result.size() < k || d < result.top()) {
-        result.push(d);
+static void addResult(int k, int id, double d, priority_queue<GNAT_result_t>& result) {
+    if ((int)result.size() < k || d < result.top().dist) {
+        result.push({id, d});
     }
     if ((int)result.size() > k) {
         result.pop();
     }
-    r = result.top();
 }
 
-void GNAT_t::_knnSearch(const GNAT_node_t* root, int query, int k,
-                        priority_queue<double>& result, double& ave_r) {
-    if (root->num < 0) {
-        auto& pivot    = root->pivot;
-        auto& children = root->children;
-        auto& max_dist = root->max_dist;
+void GNAT_t::_knnSearch(const GNAT_node_t& node, int query, int k,
+                        priority_queue<GNAT_result_t>& result) {
+    if (node.num < 0) {
+        const int* pivot   = pivots.data() + node.pivot_begin;
+        const float* table = ranges.data() + node.range_begin;
+        size_t n = node.pivot_cnt;
 
-        vector<pair<double, int>> od(pivot.size());
-        for (int i = 0; i < (int)pivot.size(); i++) {
+        vector<pair<double, int>> od(n);
+        for (int i = 0; i < (int)n; i++) {
             od[i].first  = dist(query, pivot[i]);
             od[i].second = i;
-            addResult(k, od[i].first, result, ave_r);
+            addResult(k, pivot[i], od[i].first, result);
         }
-        if (children.empty())
+        if (node.child_cnt == 0)
             return;
 
         sort(od.begin(), od.end());
-        for (int i = 0; i < (int)pivot.size(); i++) {
+        for (int i = 0; i < (int)n; i++) {
             if ((int)result.size() == k &&
-                ((od[i].first - od[0].first) / 2.0) > result.top())
+                ((od[i].first - od[0].first) / 2.0) > result.top().dist)
                 break;
+            int c = od[i].second;
             if (result.empty() ||
-                (od[i].first - result.top() <= max_dist[od[i].second][od[i].second])) {
-                _knnSearch(&children[od[i].second], query, k, result, ave_r);
+                (od[i].first - result.top().dist <= table[2 * (c * n + c) + 1])) {
+                _knnSearch(nodes[node.child_begin + c], query, k, result);
             }
         }
     } else {
-        for (int id : root->bucket) {
-            double d = dist(query, id);
-            addResult(k, d, result, ave_r);
+        for (int b = 0; b < node.num; ++b) {
+            int id = bucket[node.bucket_begin + b];
+            addResult(k, id, dist(query, id), result);
         }
     }
 }
 
+void GNAT_t::knnSearch(int query, int k, vector<GNAT_result_t>& result) {
+    priority_queue<GNAT_result_t> best;
+    if (!nodes.empty() && k > 0) _knnSearch(nodes[0], query, k, best);
+    result.resize(best.size());
+    for (size_t i = best.size(); i-- > 0; best.pop()) result[i] = best.top();
+}
+
 void GNAT_t::knnSearch(const vector<int>& queries, int k, double& ave_r) {
-    double r = 0.0;
+    vector<GNAT_result_t> result;
     for (int q : queries) {
-        priority_queue<double> result;
-        _knnSearch(&root, q, k, result, r);
-        ave_r += r;
+        result.clear();
+        knnSearch(q, k, result);
+        if (!result.empty()) ave_r += result.back().dist;
     }
 }
 
@@ -30,11 +30,14 @@ struct ObjDist {
 struct VPNode {
     bool isLeaf;
     vector<int> bucket;
+    vector<double> pathDists;     // leaf only: PATH matrix, row j = distances of bucket[j] to the path pivots
     int pivot;                    // pivot ID (if internal)
     vector<double> radii;         // partition boundaries (size = arity)
-    vector<VPNode*> children;     // children pointers
+    int pivot2;                   // second vantage point (two-VP nodes only, -1 otherwise)
+    vector<double> radii2;        // two-VP only: row i = boundaries of pivot2 inside shell i of pivot (arity x arity)
+    vector<VPNode*> children;     // children pointers (arity, or arity*arity for two-VP nodes, index i*arity+j)
 
-    VPNode() : isLeaf(false), pivot(-1) {}
+    VPNode() : isLeaf(false), pivot(-1), pivot2(-1) {}
     ~VPNode() {
         for (auto c : children) delete c;
     }
@@ -48,9 +51,13 @@ class MVPT {
 
     int configuredHeight;   // if >0, force tree height = configuredHeight (num pivots)
     vector<int> pivotsPerLevel;         // if non-empty, pivotsPerLevel[level-1] is pivot for that level (1-based)
+    int vantagePoints;      // 1 = one pivot per node, 2 = original MVP-tree nodes (two pivots, arity^2 children)
+
+    vector<vector<double>> buildPath;   // build scratch: distances of each object to the pivots above it
 
 public:
-    MVPT(ObjectDB *db, int bucketSize = 10, int arity = 2, int configuredHeight = 0, const vector<int>& pivotsPerLevel = {});
+    MVPT(ObjectDB *db, int bucketSize = 10, int arity = 2, int configuredHeight = 0, const vector<int>& pivotsPerLevel = {},
+         int vantagePoints = 1);
     ~MVPT() { delete root; }
 
     // Searches
@@ -66,20 +73,31 @@ public:
 
 private:
     VPNode* build(vector<int> ids, int depth);
-    void rangeSearch(VPNode *node, int queryId, double radius, vector<int> &result) const;
-    void knnSearch(VPNode *node, int queryId, int k, priority_queue<ResultElem> &pq, double &tau) const;
+    VPNode* makeLeaf(VPNode *node, const vector<int> &ids);
+    int choosePivot(vector<int> &ids, int level);
+    void shellPartition(vector<ObjDist> &objDists, double *bounds, vector<vector<int>> &shells) const;
+
+    // distance from d to the shell [bounds[i], bounds[i+1]) (0 if inside)
+    double shellGap(const double *bounds, int i, double d) const;
+    void rangeSearch(VPNode *node, int queryId, double radius, vector<int> &result, vector<double> &qPath) const;
+    void knnSearch(VPNode *node, int queryId, int k, priority_queue<ResultElem> &pq, double &tau, vector<double> &qPath) const;
+
+    // true if row j of the leaf PATH matrix proves d(q, bucket[j]) > r
+    static bool pathExcludes(const VPNode *leaf, int j, const vector<double> &qPath, double r);
 
     // helpers for pivot reporting
     int treeHeight(VPNode* node) const;
     void collectPivots(VPNode* node, unordered_set<int>& s) const;
 };
 
-MVPT::MVPT(ObjectDB *db, int bucketSize, int arity, int configuredHeight, const vector<int>& pivotsPerLevel)
+MVPT::MVPT(ObjectDB *db, int bucketSize, int arity, int configuredHeight, const vector<int>& pivotsPerLevel,
+           int vantagePoints)
     : db(db), root(nullptr), bucketSize(bucketSize), arity(arity),
-      configuredHeight(configuredHeight), pivotsPerLevel(pivotsPerLevel)
+      configuredHeight(configuredHeight), pivotsPerLevel(pivotsPerLevel), vantagePoints(vantagePoints)
 {
     if (arity < 2) arity = 2;
     this->arity = arity;
+    if (vantagePoints != 2) this->vantagePoints = 1;
 
     // ensure pivotsPerLevel size is not larger than configuredHeight if configured
     if (configuredHeight > 0 && !pivotsPerLevel.empty() && (int)pivotsPerLevel.size() < configuredHeight) {
@@ -90,9 +108,13 @@ MVPT::MVPT(ObjectDB *db, int bucketSize, int arity, int configuredHeight, const
     vector<int> allIds(db->size());
     iota(allIds.begin(), allIds.end(), 0);
 
+    buildPath.assign(db->size(), {});
     root = build(allIds, 1);
+    buildPath.clear();
+    buildPath.shrink_to_fit();
 
     cerr << "[MVPT] Index built (bucketSize=" << bucketSize << ", arity=" << arity
+         << ", vantagePoints=" << this->vantagePoints
          << ", configuredHeight=" << configuredHeight
          << ", pivotsProvided=" << (pivotsPerLevel.empty() ? 0 : (int)pivotsPerLevel.size()) << ")\n";
 }
@@ -102,93 +124,159 @@ VPNode* MVPT::build(vector<int> ids, int depth)
     VPNode *node = new VPNode();
 
     // stop splitting when depth >= configuredHeight (so height == configuredHeight)
-    if (configuredHeight > 0 && depth >= configuredHeight) {
-        node->isLeaf = true;
-        node->bucket = ids;
-        return node;
-    }
+    if (configuredHeight > 0 && depth >= configuredHeight)
+        return makeLeaf(node, ids);
 
     // base: bucket-size small -> leaf
-    if ((int)ids.size() <= bucketSize) {
-        node->isLeaf = true;
-        node->bucket = ids;
-        return node;
-    }
+    if ((int)ids.size() <= bucketSize)
+        return makeLeaf(node, ids);
 
-    // internal node: choose pivot
+    // internal node: choose pivot (pivot levels are 1-based; a two-VP node consumes levels depth and depth+1)
     node->isLeaf = false;
+    node->pivot = choosePivot(ids, depth);
+
+    // second vantage point only if its level still fits under configuredHeight
+    bool twoVP = vantagePoints == 2 && !ids.empty()
+                 && (configuredHeight <= 0 || depth + 1 < configuredHeight);
+    if (twoVP) node->pivot2 = choosePivot(ids, depth + 1);
+
+    // compute distances to pivot
+    vector<ObjDist> objDists;
+    objDists.reserve(ids.size());
+    for (int id : ids) {
+        double d = db->distance(id, node->pivot);
+        compdistsBuild++;
+        objDists.push_back({id, d});
+        buildPath[id].push_back(d);
+    }
+
+    // partition into arity shells around pivot
+    node->radii.resize(arity);
+    vector<vector<int>> shells;
+    shellPartition(objDists, node->radii.data(), shells);
+
+    if (!twoVP) {
+        node->children.resize(arity, nullptr);
+        for (int i = 0; i < arity; i++)
+            if (!shells[i].empty()) node->children[i] = build(shells[i], depth + 1);
+    } else {
+        // pivot2 splits every shell of pivot into arity sub-shells
+        node->radii2.resize(arity * arity);
+        node->children.resize(arity * arity, nullptr);
+        for (int i = 0; i < arity; i++) {
+            vector<ObjDist> subDists;
+            subDists.reserve(shells[i].size());
+            for (int id : shells[i]) {
+                double d = db->distance(id, node->pivot2);
+                compdistsBuild++;
+                subDists.push_back({id, d});
+                buildPath[id].push_back(d);
+            }
+
+            vector<vector<int>> subShells;
+            shellPartition(subDists, node->radii2.data() + i * arity, subShells);
+            for (int j = 0; j < arity; j++)
+                if (!subShells[j].empty()) node->children[i * arity + j] = build(subShells[j], depth + 2);
+        }
+        for (int id : ids) buildPath[id].pop_back();
+    }
+
+    for (int id : ids) buildPath[id].pop_back();
+
+    compdists = compdistsBuild;
+    return node;
+}
+
+int MVPT::choosePivot(vector<int> &ids, int level)
+{
     int pivotId = -1;
 
-    // If pivots per level provided and has an entry for this depth -> use it (levels are 1-based)
-    if (!pivotsPerLevel.empty() && (depth - 1) < (int)pivotsPerLevel.size()) {
-        pivotId = pivotsPerLevel[depth - 1];
+    // If pivots per level provided and has an entry for this level -> use it
+    if (!pivotsPerLevel.empty() && (level - 1) < (int)pivotsPerLevel.size()) {
+        pivotId = pivotsPerLevel[level - 1];
         // If pivot is not present in current ids, we still keep it (it's allowed; distances computed for all ids)
     } else {
         // fallback: choose pivot randomly among current ids
         int pivotIdx = rand() % ids.size();
         pivotId = ids[pivotIdx];
     }
-    node->pivot = pivotId;
 
     // Remove pivot from ids if present (so pivot isn't duplicated in children)
     auto it = find(ids.begin(), ids.end(), pivotId);
     if (it != ids.end()) ids.erase(it);
+    return pivotId;
+}
 
-    // compute distances to pivot
-    vector<ObjDist> objDists;
-    objDists.reserve(ids.size());
-    for (int id : ids) {
-        double d = db->distance(id, node->pivot);
-        compdistsBuild++;
-        objDists.push_back({id, d});
-    }
-
+void MVPT::shellPartition(vector<ObjDist> &objDists, double *bounds, vector<vector<int>> &shells) const
+{
     // sort distances
     sort(objDists.begin(), objDists.end());
 
-    // prepare node radii and children
-    node->radii.resize(arity);
-    node->children.resize(arity, nullptr);
-
     int n = (int)objDists.size();
     int perChild = n / arity;
     int remainder = n % arity;
 
-    node->radii[0] = 0.0;
+    bounds[0] = 0.0;
     for (int i = 1; i < arity; i++) {
         int idx = i * perChild + min(i, remainder) - 1;
-        if (idx >= 0 && idx < n) node->radii[i] = objDists[idx].dist;
-        else node->radii[i] = numeric_limits<double>::infinity();
+        if (idx >= 0 && idx < n) bounds[i] = objDists[idx].dist;
+        else bounds[i] = numeric_limits<double>::infinity();
     }
 
+    shells.assign(arity, {});
     int startIdx = 0;
     for (int i = 0; i < arity; i++) {
         int count = perChild + (i < remainder ? 1 : 0);
         int endIdx = min(startIdx + count, n);
 
-        vector<int> childIds;
-        childIds.reserve(max(0, endIdx - startIdx));
-        for (int j = startIdx; j < endIdx; j++) childIds.push_back(objDists[j].id);
-
-        if (!childIds.empty()) node->children[i] = build(childIds, depth + 1);
-        else node->children[i] = nullptr;
+        shells[i].reserve(max(0, endIdx - startIdx));
+        for (int j = startIdx; j < endIdx; j++) shells[i].push_back(objDists[j].id);
 
         startIdx = endIdx;
     }
+}
 
-    compdists = compdistsBuild;
+double MVPT::shellGap(const double *bounds, int i, double d) const
+{
+    double lowerBound = bounds[i];
+    double upperBound = (i + 1 < arity) ? bounds[i + 1] : numeric_limits<double>::infinity();
+    return max({0.0, lowerBound - d, d - upperBound});
+}
+
+VPNode* MVPT::makeLeaf(VPNode *node, const vector<int> &ids)
+{
+    node->isLeaf = true;
+    node->bucket = ids;
+
+    // keep the root-to-leaf pivot distances already computed during build
+    size_t pathLen = ids.empty() ? 0 : buildPath[ids[0]].size();
+    node->pathDists.reserve(ids.size() * pathLen);
+    for (int id : ids)
+        node->pathDists.insert(node->pathDists.end(), buildPath[id].begin(), buildPath[id].end());
     return node;
 }
 
+bool MVPT::pathExcludes(const VPNode *leaf, int j, const vector<double> &qPath, double r)
+{
+    size_t pathLen = qPath.size();
+    const double *row = leaf->pathDists.data() + j * pathLen;
+    for (size_t i = 0; i < pathLen; i++)
+        if (fabs(qPath[i] - row[i]) > r) return true;
+    return false;
+}
+
 void MVPT::rangeSearch(int queryId, double radius, vector<int> &result) const {
-    rangeSearch(root, queryId, radius, result);
+    vector<double> qPath;
+    rangeSearch(root, queryId, radius, result, qPath);
 }
 
-void MVPT::rangeSearch(VPNode *node, int queryId, double radius, vector<int> &result) const {
+void MVPT::rangeSearch(VPNode *node, int queryId, double radius, vector<int> &result, vector<double> &qPath) const {
     if (!node) return;
 
     if (node->isLeaf) {
-        for (int id : node->bucket) {
+        for (int j = 0; j < (int)node->bucket.size(); j++) {
+            if (pathExcludes(node, j, qPath, radius)) continue;
+            int id = node->bucket[j];
             double d = db->distance(queryId, id);
             compdists++;
             if (d <= radius) result.push_back(id);
@@ -200,31 +288,54 @@ void MVPT::rangeSearch(VPNode *node, int queryId, double radius, vector<int> &re
     compdists++;
     if (distToPivot <= radius) result.push_back(node->pivot);
 
-    for (int i = 0; i < arity; i++) {
-        if (!node->children[i]) continue;
-        double lowerBound = node->radii[i];
-        double upperBound = (i + 1 < arity) ? node->radii[i + 1] : numeric_limits<double>::infinity();
+    if (node->pivot2 < 0) {
+        qPath.push_back(distToPivot);
+        for (int i = 0; i < arity; i++) {
+            if (!node->children[i]) continue;
+            // pruning: check intersection of [distToPivot - radius, distToPivot + radius] with shell i
+            if (shellGap(node->radii.data(), i, distToPivot) <= radius)
+                rangeSearch(node->children[i], queryId, radius, result, qPath);
+        }
+        qPath.pop_back();
+        return;
+    }
+
+    // two-VP node: shell i of pivot, then sub-shell j of pivot2
+    double distToPivot2 = db->distance(queryId, node->pivot2);
+    compdists++;
+    if (distToPivot2 <= radius) result.push_back(node->pivot2);
 
-        // pruning: check intersection of [distToPivot - radius, distToPivot + radius] with [lowerBound, upperBound]
-        if (distToPivot - radius <= upperBound && distToPivot + radius >= lowerBound) {
-            rangeSearch(node->children[i], queryId, radius, result);
+    qPath.push_back(distToPivot);
+    qPath.push_back(distToPivot2);
+    for (int i = 0; i < arity; i++) {
+        if (shellGap(node->radii.data(), i, distToPivot) > radius) continue;
+        const double *bounds2 = node->radii2.data() + i * arity;
+        for (int j = 0; j < arity; j++) {
+            VPNode *child = node->children[i * arity + j];
+            if (child && shellGap(bounds2, j, distToPivot2) <= radius)
+                rangeSearch(child, queryId, radius, result, qPath);
         }
     }
+    qPath.pop_back();
+    qPath.pop_back();
 }
 
 void MVPT::knnSearch(int queryId, int k, vector<ResultElem> &out) const {
     priority_queue<ResultElem> pq;
     double tau = numeric_limits<double>::infinity();
-    knnSearch(root, queryId, k, pq, tau);
+    vector<double> qPath;
+    knnSearch(root, queryId, k, pq, tau, qPath);
     while (!pq.empty()) { out.push_back(pq.top()); pq.pop(); }
     reverse(out.begin(), out.end());
 }
 
-void MVPT::knnSearch(VPNode *node, int queryId, int k, priority_queue<ResultElem> &pq, double &tau) const {
+void MVPT::knnSearch(VPNode *node, int queryId, int k, priority_queue<ResultElem> &pq, double &tau, vector<double> &qPath) const {
     if (!node) return;
 
     if (node->isLeaf) {
-        for (int id : node->bucket) {
+        for (int j = 0; j < (int)node->bucket.size(); j++) {
+            if ((int)pq.size() == k && pathExcludes(node, j, qPath, tau)) continue;
+            int id = node->bucket[j];
             double d = db->distance(queryId, id);
             compdists++;
             if ((int)pq.size() < k) { pq.push({id, d}); if ((int)pq.size() == k) tau = pq.top().dist; }
@@ -238,6 +349,35 @@ void MVPT::knnSearch(VPNode *node, int queryId, int k, priority_queue<ResultElem
     if ((int)pq.size() < k) { pq.push({node->pivot, distToPivot}); if ((int)pq.size() == k) tau = pq.top().dist; }
     else if (distToPivot < pq.top().dist) { pq.pop(); pq.push({node->pivot, distToPivot}); tau = pq.top().dist; }
 
+    if (node->pivot2 >= 0) {
+        double distToPivot2 = db->distance(queryId, node->pivot2);
+        compdists++;
+        if ((int)pq.size() < k) { pq.push({node->pivot2, distToPivot2}); if ((int)pq.size() == k) tau = pq.top().dist; }
+        else if (distToPivot2 < pq.top().dist) { pq.pop(); pq.push({node->pivot2, distToPivot2}); tau = pq.top().dist; }
+
+        // visit the arity^2 children in increasing lower-bound order
+        vector<pair<double, int>> order;
+        for (int i = 0; i < arity; i++) {
+            double gap1 = shellGap(node->radii.data(), i, distToPivot);
+            for (int j = 0; j < arity; j++) {
+                if (!node->children[i * arity + j]) continue;
+                double gap2 = shellGap(node->radii2.data() + i * arity, j, distToPivot2);
+                order.push_back({max(gap1, gap2), i * arity + j});
+            }
+        }
+        sort(order.begin(), order.end());
+
+        qPath.push_back(distToPivot);
+        qPath.push_back(distToPivot2);
+        for (auto &[lb, c] : order) {
+            if ((int)pq.size() == k && lb > tau) break;
+            knnSearch(node->children[c], queryId, k, pq, tau, qPath);
+        }
+        qPath.pop_back();
+        qPath.pop_back();
+        return;
+    }
+
     int closestChild = 0;
     for (int i = 1; i < arity; i++) {
         if (node->radii[i] > distToPivot) { closestChild = i - 1; break; }
@@ -251,15 +391,14 @@ void MVPT::knnSearch(VPNode *node, int queryId, int k, priority_queue<ResultElem
         if (closestChild + d < arity) order.push_back(closestChild + d);
     }
 
+    qPath.push_back(distToPivot);
     for (int i : order) {
         if (!node->children[i]) continue;
-        double lowerBound = node->radii[i];
-        double upperBound = (i + 1 < arity) ? node->radii[i + 1] : numeric_limits<double>::infinity();
-
-        if ((int)pq.size() < k || (distToPivot - tau <= upperBound && distToPivot + tau >= lowerBound)) {
-            knnSearch(node->children[i], queryId, k, pq, tau);
+        if ((int)pq.size() < k || shellGap(node->radii.data(), i, distToPivot) <= tau) {
+            knnSearch(node->children[i], queryId, k, pq, tau, qPath);
         }
     }
+    qPath.pop_back();
 }
 
 // helpers
@@ -274,6 +413,7 @@ int MVPT::treeHeight(VPNode* node) const {
 void MVPT::collectPivots(VPNode* node, unordered_set<int>& s) const {
     if (!node) return;
     if (!node->isLeaf && node->pivot >= 0) s.insert(node->pivot);
+    if (!node->isLeaf && node->pivot2 >= 0) s.insert(node->pivot2);
     for (auto c : node->children) if (c) collectPivots(c, s);
 }
 
@@ -93,9 +93,10 @@ int main(int argc, char** argv)
             // Build MVPT: configuredHeight = nPivots, arity fixed to 5 (to mirror paper)
             const int MVPT_BUCKET_SIZE = 20;
             const int MVPT_ARITY = 5;
+            const int MVPT_VANTAGE_POINTS = 1;   // 2 = original MVP-tree nodes (arity^2 children per node)
 
             auto t0 = chrono::high_resolution_clock::now();
-            MVPT index(db.get(), MVPT_BUCKET_SIZE, MVPT_ARITY, nPivots, pivots);
+            MVPT index(db.get(), MVPT_BUCKET_SIZE, MVPT_ARITY, nPivots, pivots, MVPT_VANTAGE_POINTS);
             auto t1 = chrono::high_resolution_clock::now();
             double buildTimeMs = chrono::duration_cast<chrono::milliseconds>(t1 - t0).count();
 
@@ -7,6 +7,7 @@
 #include <limits>
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 
 // Resultado para kNN específico de SAT
 struct SATResultElem
@@ -22,8 +23,10 @@ class SAT
         int center;                // id del objeto centro
         double maxDist;            // radio: max dist a objetos en su subárbol
         std::vector<int> children; // índices de hijos en "nodes"
+        int parent;                // índice del padre (-1 en la raíz)
+        std::vector<double> ancDist; // ancDist[i] = d(center, centro del ancestro i) (0 = padre, 1 = abuelo, ...)
 
-        Node(int c = -1) : center(c), maxDist(0.0) {}
+        Node(int c = -1, int p = -1) : center(c), maxDist(0.0), parent(p) {}
     };
 
     // Elementos usados solo durante la construcción (cola/queue del SAT original)
@@ -53,6 +56,8 @@ class SAT
     };
 
     const ObjectDB *db;
+    bool distal;  // true = DiSAT: los vecinos se eligen del más lejano al más cercano
+    int numAncestors; // cuántos ancestros (padre incluido) guardan su distancia en cada nodo
 
     std::vector<Node> nodes;                         // nodos del SAT
     std::vector<std::vector<BuildQueueElem>> queues; // colas por nodo (solo build)
@@ -65,8 +70,10 @@ class SAT
 
 public:
 
-    SAT(const ObjectDB *db_)
-        : db(db_), rootId(-1) {}
+    SAT(const ObjectDB *db_, bool distal_ = false, int numAncestors_ = 4)
+        : db(db_), distal(distal_), numAncestors(std::max(0, numAncestors_)), rootId(-1) {}
+
+    bool is_distal() const { return distal; }
 
     void build()
     {
@@ -112,8 +119,9 @@ public:
         double d0 = distQuery(qId, nodes[rootId].center);
         double mind = d0;   // mínima distancia a cualquier centro en el camino
         double s    = 0.0;  // digresión acumulada (Navarro)
+        std::vector<double> qPath{d0}; // d(q, centro) de la raíz al nodo actual
 
-        searchRangeRec(rootId, qId, r, d0, mind, s, res);
+        searchRangeRec(rootId, qId, r, d0, mind, s, qPath, res);
 
         queryTime += std::chrono::duration_cast<std::chrono::microseconds>(
                          Clock::now() - start)
@@ -154,6 +162,8 @@ public:
 
         // vector temporal de distancias a hijos (tamaño máximo: nº de nodos)
         std::vector<double> dd(nodes.size());
+        // d(q, centro) de cada nodo ya expandido, para las cotas por ancestros
+        std::vector<double> qd(nodes.size());
 
         // Inicializar con la raíz (mismo esquema que searchNN en sat.c)
         double dist0 = distQuery(qId, nodes[rootId].center);
@@ -172,6 +182,7 @@ public:
                 break;
 
             const Node &N = nodes[hel.nodeId];
+            qd[hel.nodeId] = hel.dist;
 
             // Añadir centro actual a los candidatos
             best.push({hel.dist, N.center});
@@ -184,11 +195,28 @@ public:
             int m = static_cast<int>(N.children.size());
             if (m == 0) continue;
 
-            // Calcular distancias a hijos y actualizar mind (hel.mind)
+            // Calcular distancias a hijos y actualizar mind (hel.mind).
+            // Si las distancias a ancestros ya prueban que el subárbol no mejora
+            // el k-ésimo vecino, el centro del hijo no se evalúa.
             for (int j = 0; j < m; ++j)
             {
-                int childId = N.children[j];
-                dd[j] = distQuery(qId, nodes[childId].center);
+                const Node &C = nodes[N.children[j]];
+                if ((int)best.size() == k)
+                {
+                    double lbc = 0.0;
+                    int a = hel.nodeId;
+                    for (double da : C.ancDist)
+                    {
+                        lbc = std::max(lbc, std::fabs(qd[a] - da));
+                        a = nodes[a].parent;
+                    }
+                    if (std::max(hel.lbound, lbc - C.maxDist) >= currentRadius)
+                    {
+                        dd[j] = std::numeric_limits<double>::infinity();
+                        continue;
+                    }
+                }
+                dd[j] = distQuery(qId, C.center);
                 if (dd[j] < hel.mind) hel.mind = dd[j];
             }
 
@@ -197,6 +225,7 @@ public:
             {
                 int childId = N.children[j];
                 double dchild = dd[j];
+                if (dchild == std::numeric_limits<double>::infinity()) continue;
 
                 double lb = hel.lbound;
                 double tmp = (dchild - hel.mind) / 2.0;
@@ -238,14 +267,24 @@ private:
         return db->distance(a, b);
     }
 
-    int newNode(int objId)
+    int newNode(int objId, int parentId = -1)
     {
         int id = static_cast<int>(nodes.size());
-        nodes.emplace_back(objId);
+        nodes.emplace_back(objId, parentId);
         queues.emplace_back(); // cola vacía para este nodo
         return id;
     }
 
+    // Guarda en el nodo sus distancias al padre (ya conocida) y a los siguientes ancestros
+    void setAncestorDists(int nodeId, double parentDist)
+    {
+        Node &c = nodes[nodeId];
+        if (numAncestors == 0) return;
+        c.ancDist.push_back(parentDist);
+        for (int a = nodes[c.parent].parent; a >= 0 && (int)c.ancDist.size() < numAncestors; a = nodes[a].parent)
+            c.ancDist.push_back(distBuild(c.center, nodes[a].center));
+    }
+
     void distribute(int nodeId)
     {
         Node &node = nodes[nodeId];
@@ -257,12 +296,17 @@ private:
             return;
         }
 
-        // Ordenar cola por distancia creciente 
-        std::sort(Q.begin(), Q.end(),
-                  [](const BuildQueueElem &a, const BuildQueueElem &b)
-                  { return a.dist < b.dist; });
+        // Ordenar cola por distancia creciente (SAT) o decreciente (DiSAT)
+        if (distal)
+            std::sort(Q.begin(), Q.end(),
+                      [](const BuildQueueElem &a, const BuildQueueElem &b)
+                      { return a.dist > b.dist; });
+        else
+            std::sort(Q.begin(), Q.end(),
+                      [](const BuildQueueElem &a, const BuildQueueElem &b)
+                      { return a.dist < b.dist; });
 
-        node.maxDist = Q.back().dist;
+        node.maxDist = distal ? Q.front().dist : Q.back().dist;
 
         int ni = 0;
 
@@ -286,8 +330,9 @@ private:
 
             if (q.bestChild == -1)
             {
-                // se convierte en nuevo vecino/centro
-                int newChildId = newNode(q.objId);
+                // se convierte en nuevo vecino/centro (q.dist sigue siendo su distancia a este centro)
+                int newChildId = newNode(q.objId, nodeId);
+                setAncestorDists(newChildId, q.dist);
                 node.children.push_back(newChildId);
             }
             else
@@ -328,6 +373,7 @@ private:
 
     void searchRangeRec(int nodeId, int qId, double r,
                         double d0, double mind, double s,
+                        std::vector<double> &qPath,
                         std::vector<int> &res) const
     {
         const Node &N = nodes[nodeId];
@@ -348,11 +394,21 @@ private:
         std::vector<double> dd(m);
         double newMind = mind;
 
-        // distancias a hijos + actualizar newMind (mínima dist a centros)
+        // distancias a hijos + actualizar newMind (mínima dist a centros).
+        // Antes, cota por ancestros: |d(q,a) - d(c,a)| <= d(q,c); si ni el hijo
+        // ni su bola de radio maxDist pueden tocar la consulta, no se evalúa.
         for (int j = 0; j < m; ++j)
         {
-            int childId = N.children[j];
-            dd[j] = distQuery(qId, nodes[childId].center);
+            const Node &C = nodes[N.children[j]];
+            double lbc = 0.0;
+            for (int i = 0; i < (int)C.ancDist.size(); ++i)
+                lbc = std::max(lbc, std::fabs(qPath[qPath.size() - 1 - i] - C.ancDist[i]));
+            if (lbc - C.maxDist > r)
+            {
+                dd[j] = std::numeric_limits<double>::infinity();
+                continue;
+            }
+            dd[j] = distQuery(qId, C.center);
             if (dd[j] < newMind) newMind = dd[j];
         }
 
@@ -365,7 +421,9 @@ private:
             if (dd[j] <= newMind + 2.0 * r)
             {
                 double newS = std::max(0.0, s + (dd[j] - d0));
-                searchRangeRec(childId, qId, r, dd[j], newMind, newS, res);
+                qPath.push_back(dd[j]);
+                searchRangeRec(childId, qId, r, dd[j], newMind, newS, qPath, res);
+                qPath.pop_back();
             }
         }
     }
@@ -13,6 +13,9 @@ static const vector<string> DATASETS = {"LA", "Words", "Color", "Synthetic"};
 // Valores "equivalentes" de número de pivotes m = {3,5,10,15,20}
 static const vector<int> L_VALUES = {3, 5, 10, 15, 20};
 
+// Variantes de construcción evaluadas: false = SAT, true = DiSAT
+static const vector<bool> BUILD_VARIANTS = {false, true};
+
 
 int main(int argc, char** argv)
 {
@@ -76,132 +79,137 @@ int main(int argc, char** argv)
         J << "[\n";
         bool firstOutput = true;
 
-        cerr << "[INFO] Construyendo SAT...\n";
-
-        SAT sat(db.get());
+        // SAT original (vecinos del más cercano al más lejano) y DiSAT (del más lejano al más cercano)
+        for (bool distal : BUILD_VARIANTS)
+        {
+            const string indexName = distal ? "DiSAT" : "SAT";
+            cerr << "[INFO] Construyendo " << indexName << "...\n";
 
-        auto tStart = chrono::high_resolution_clock::now();
-        sat.build();
-        auto tEnd = chrono::high_resolution_clock::now();
+            SAT sat(db.get(), distal);
 
-        long long buildTime = chrono::duration_cast<chrono::milliseconds>(tEnd - tStart).count();
-        int height = sat.get_height();
-        int numCenters = sat.get_num_pivots(); // número de nodos/centros del SAT
+            auto tStart = chrono::high_resolution_clock::now();
+            sat.build();
+            auto tEnd = chrono::high_resolution_clock::now();
 
-        cerr << "[INFO] SAT construido: altura=" << height
-             << "   nodos=" << numCenters
-             << "   tiempo=" << buildTime << " ms\n";
+            long long buildTime = chrono::duration_cast<chrono::milliseconds>(tEnd - tStart).count();
+            int height = sat.get_height();
+            int numCenters = sat.get_num_pivots(); // número de nodos/centros del SAT
 
-        cerr << "[INFO] Ejecutando MRQ queries...\n";
+            cerr << "[INFO] " << indexName << " construido: altura=" << height
+                 << "   nodos=" << numCenters
+                 << "   tiempo=" << buildTime << " ms\n";
 
-        for (double sel : SELECTIVITIES)
-        {
-            // Si no hay radio precomputado para esta selectividad, saltamos
-            if (radii.find(sel) == radii.end())
-                continue;
+            cerr << "[INFO] Ejecutando MRQ queries...\n";
 
-            double R = radii[sel];
-
-            // Para cada valor "equivalente" de número de pivotes m
-            for (int li = 0; li < (int)L_VALUES.size(); ++li)
+            for (double sel : SELECTIVITIES)
             {
-                int l_value = L_VALUES[li];
+                // Si no hay radio precomputado para esta selectividad, saltamos
+                if (radii.find(sel) == radii.end())
+                    continue;
 
-                long long totalD = 0;
-                long long totalT = 0;
+                double R = radii[sel];
 
-                // Ejecutar TODAS las queries para este radio
-                for (int q : queries)
+                // Para cada valor "equivalente" de número de pivotes m
+                for (int li = 0; li < (int)L_VALUES.size(); ++li)
                 {
-                    vector<int> out;
-                    sat.clear_counters();
-                    sat.rangeSearch(q, R, out);
-
-                    totalD += sat.get_compDist();
-                    totalT += sat.get_queryTime(); // μs acumulados
+                    int l_value = L_VALUES[li];
+
+                    long long totalD = 0;
+                    long long totalT = 0;
+
+                    // Ejecutar TODAS las queries para este radio
+                    for (int q : queries)
+                    {
+                        vector<int> out;
+                        sat.clear_counters();
+                        sat.rangeSearch(q, R, out);
+
+                        totalD += sat.get_compDist();
+                        totalT += sat.get_queryTime(); // μs acumulados
+                    }
+
+                    double avgD = static_cast<double>(totalD) / static_cast<double>(queries.size());
+                    double avgT = static_cast<double>(totalT) / static_cast<double>(queries.size()); // μs/query
+
+                    if (!firstOutput)
+                        J << ",\n";
+                    firstOutput = false;
+
+                    J << fixed << setprecision(6);
+                    J << "{"
+                      << "\"index\":\"" << indexName << "\","
+                      << "\"dataset\":\"" << dataset << "\","
+                      // categoría: compact-partitioning
+                      << "\"category\":\"CP\","
+                      // num_pivots = L (3,5,10,15,20) para graficar en el eje X como Chen
+                      << "\"num_pivots\":" << l_value << ","
+                      // num_centers_path: usamos la altura del SAT como #centros en un camino
+                      << "\"num_centers_path\":" << height << ","
+                      << "\"arity\":null,"
+                      << "\"query_type\":\"MRQ\","
+                      << "\"selectivity\":" << sel << ","
+                      << "\"radius\":" << R << ","
+                      << "\"k\":null,"
+                      << "\"compdists\":" << avgD << ","
+                      << "\"time_ms\":" << (avgT / 1000.0) << ","  // μs → ms
+                      << "\"n_queries\":" << queries.size() << ","
+                      << "\"run_id\":1"
+                      << "}";
                 }
-
-                double avgD = static_cast<double>(totalD) / static_cast<double>(queries.size());
-                double avgT = static_cast<double>(totalT) / static_cast<double>(queries.size()); // μs/query
-
-                if (!firstOutput)
-                    J << ",\n";
-                firstOutput = false;
-
-                J << fixed << setprecision(6);
-                J << "{"
-                  << "\"index\":\"SAT\","
-                  << "\"dataset\":\"" << dataset << "\","
-                  // categoría: compact-partitioning
-                  << "\"category\":\"CP\","
-                  // num_pivots = L (3,5,10,15,20) para graficar en el eje X como Chen
-                  << "\"num_pivots\":" << l_value << ","
-                  // num_centers_path: usamos la altura del SAT como #centros en un camino
-                  << "\"num_centers_path\":" << height << ","
-                  << "\"arity\":null,"
-                  << "\"query_type\":\"MRQ\","
-                  << "\"selectivity\":" << sel << ","
-                  << "\"radius\":" << R << ","
-                  << "\"k\":null,"
-                  << "\"compdists\":" << avgD << ","
-                  << "\"time_ms\":" << (avgT / 1000.0) << ","  // μs → ms
-                  << "\"n_queries\":" << queries.size() << ","
-                  << "\"run_id\":1"
-                  << "}";
             }
-        }
 
-        cerr << "[INFO] Ejecutando MkNN queries...\n";
+            cerr << "[INFO] Ejecutando MkNN queries...\n";
 
-        for (int k : K_VALUES)
-        {
-            // Para cada valor "equivalente" de número de pivotes m
-            for (int li = 0; li < (int)L_VALUES.size(); ++li)
+            for (int k : K_VALUES)
             {
-                int l_value = L_VALUES[li];
-
-                long long totalD = 0;
-                long long totalT = 0;
-                double sumRadius = 0.0;
-
-                // Ejecutar TODAS las queries para este k
-                for (int q : queries)
+                // Para cada valor "equivalente" de número de pivotes m
+                for (int li = 0; li < (int)L_VALUES.size(); ++li)
                 {
-                    sat.clear_counters();
-                    auto res = sat.knnQuery(q, k);
-
-                    totalD += sat.get_compDist();
-                    totalT += sat.get_queryTime(); // μs acumulados
-
-                    if (!res.empty())
-                        sumRadius += res.back().first; // distancia al k-ésimo vecino
+                    int l_value = L_VALUES[li];
+
+                    long long totalD = 0;
+                    long long totalT = 0;
+                    double sumRadius = 0.0;
+
+                    // Ejecutar TODAS las queries para este k
+                    for (int q : queries)
+                    {
+                        sat.clear_counters();
+                        auto res = sat.knnQuery(q, k);
+
+                        totalD += sat.get_compDist();
+                        totalT += sat.get_queryTime(); // μs acumulados
+
+                        if (!res.empty())
+                            sumRadius += res.back().first; // distancia al k-ésimo vecino
+                    }
+
+                    double avgD = static_cast<double>(totalD) / static_cast<double>(queries.size());
+                    double avgT = static_cast<double>(totalT) / static_cast<double>(queries.size()); // μs/query
+                    double avgRadius = sumRadius / static_cast<double>(queries.size());
+
+                    if (!firstOutput)
+                        J << ",\n";
+                    firstOutput = false;
+
+                    J << fixed << setprecision(6);
+                    J << "{"
+                      << "\"index\":\"" << indexName << "\","
+                      << "\"dataset\":\"" << dataset << "\","
+                      << "\"category\":\"CP\","
+                      << "\"num_pivots\":" << l_value << ","
+                      << "\"num_centers_path\":" << height << ","
+                      << "\"arity\":null,"
+                      << "\"query_type\":\"MkNN\","
+                      << "\"selectivity\":null,"
+                      << "\"radius\":" << avgRadius << ","   // radio efectivo medio (distancia al k-ésimo)
+                      << "\"k\":" << k << ","
+                      << "\"compdists\":" << avgD << ","
+                      << "\"time_ms\":" << (avgT / 1000.0) << ","
+                      << "\"n_queries\":" << queries.size() << ","
+                      << "\"run_id\":1"
+                      << "}";
                 }
-
-                double avgD = static_cast<double>(totalD) / static_cast<double>(queries.size());
-                double avgT = static_cast<double>(totalT) / static_cast<double>(queries.size()); // μs/query
-                double avgRadius = sumRadius / static_cast<double>(queries.size());
-
-                if (!firstOutput)
-                    J << ",\n";
-                firstOutput = false;
-
-                J << fixed << setprecision(6);
-                J << "{"
-                  << "\"index\":\"SAT\","
-                  << "\"dataset\":\"" << dataset << "\","
-                  << "\"category\":\"CP\","
-                  << "\"num_pivots\":" << l_value << ","
-                  << "\"num_centers_path\":" << height << ","
-                  << "\"arity\":null,"
-                  << "\"query_type\":\"MkNN\","
-                  << "\"selectivity\":null,"
-                  << "\"radius\":" << avgRadius << ","   // radio efectivo medio (distancia al k-ésimo)
-                  << "\"k\":" << k << ","
-                  << "\"compdists\":" << avgD << ","
-                  << "\"time_ms\":" << (avgT / 1000.0) << ","
-                  << "\"n_queries\":" << queries.size() << ","
-                  << "\"run_id\":1"
-                  << "}";
             }
         }
 
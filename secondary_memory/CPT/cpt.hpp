@@ -2,6 +2,7 @@
 #define CPT_HPP
 
 #include "../../objectdb.hpp"
+#include "../M-Tree/mtree.hpp"
 
 #include <vector>
 #include <queue>
@@ -11,7 +12,14 @@
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 struct CPTResultElem {
     int id;
@@ -51,10 +59,16 @@ public:
         }
 
         buildDefaultPages();
+        pagesChanged();
 
         buildDistanceTable();
     }
 
+    ~CPT() { closePageFile(); }
+
+    CPT(const CPT&) = delete;
+    CPT& operator=(const CPT&) = delete;
+
     void overridePivots(const std::vector<int>& newPivots) {
         if (!db) return;
         if ((int)newPivots.size() != nPivots) {
@@ -83,69 +97,27 @@ public:
         pages.clear();
 
         std::string indexPath = basePath + ".mtree_index";
-        FILE* fp = std::fopen(indexPath.c_str(), "rb");
-        if (!fp) {
-            std::cerr << "[CPT] buildFromMTree: cannot open " << indexPath << "\n";
-            buildDefaultPages();
-            return;
-        }
 
-        int64_t rootOffset;
-        if (std::fread(&rootOffset, sizeof(int64_t), 1, fp) != 1) {
-            std::cerr << "[CPT] buildFromMTree: corrupted file (no rootOffset)\n";
-            std::fclose(fp);
+        // Lectura del índice M-tree (formato paginado o antiguo)
+        int64_t rootOffset = -1;
+        std::vector<MTree_Disk::RawNode> rawNodes;
+        if (!MTree_Disk::loadAllNodes(indexPath, rootOffset, rawNodes)) {
+            std::cerr << "[CPT] buildFromMTree: cannot read " << indexPath << "\n";
             buildDefaultPages();
+            pagesChanged();
             return;
         }
 
-        // Scan all nodes sequentially
-        while (true) {
-            bool isLeaf;
-            int32_t count;
-
-            size_t r1 = std::fread(&isLeaf, sizeof(bool), 1, fp);
-            if (r1 != 1) {
-                // EOF or error
-                if (!std::feof(fp)) {
-                    std::cerr << "[CPT] buildFromMTree: fread(isLeaf) failed\n";
-                }
-                break;
-            }
-            if (std::fread(&count, sizeof(int32_t), 1, fp) != 1) {
-                std::cerr << "[CPT] buildFromMTree: fread(count) failed\n";
-                break;
-            }
-
+        // Una página CPT por hoja del M-tree, en el orden del archivo
+        for (const auto& node : rawNodes) {
+            if (!node.isLeaf || node.entries.empty()) continue;
             std::vector<int> leafObjs;
-            leafObjs.reserve(count);
-
-            for (int i = 0; i < count; ++i) {
-                int32_t objId;
-                double radius;
-                double parentDist;
-                int64_t childOffset;
-
-                if (std::fread(&objId,      sizeof(int32_t), 1, fp) != 1 ||
-                    std::fread(&radius,     sizeof(double),  1, fp) != 1 ||
-                    std::fread(&parentDist, sizeof(double),  1, fp) != 1 ||
-                    std::fread(&childOffset,sizeof(int64_t), 1, fp) != 1) {
-                    std::cerr << "[CPT] buildFromMTree: fread(entry) failed\n";
-                    leafObjs.clear();
-                    break;
-                }
-
-                if (isLeaf) {
-                    leafObjs.push_back(objId);
-                }
-            }
-
-            if (isLeaf && !leafObjs.empty()) {
-                pages.push_back(std::move(leafObjs));
-            }
+            leafObjs.reserve(node.entries.size());
+            for (const auto& e : node.entries)
+                leafObjs.push_back(e.objId);
+            pages.push_back(std::move(leafObjs));
         }
 
-        std::fclose(fp);
-
         if (pages.empty()) {
             std::cerr << "[CPT] buildFromMTree: no leaf pages found, "
                          "falling back to default single page.\n";
@@ -154,10 +126,14 @@ public:
             std::cerr << "[CPT] buildFromMTree: built " << pages.size()
                       << " pages clustered from M-tree.\n";
         }
+
+        pagePath = basePath + ".cpt_pages";
+        pagesChanged();
     }
 
     void setPages(const std::vector<std::vector<int>>& newPages) {
         pages = newPages;
+        pagesChanged();
     }
 
     void buildSequentialPages(int objectsPerPage) {
@@ -175,8 +151,60 @@ public:
             }
         }
         if (!current.empty()) pages.push_back(current);
+        pagesChanged();
+    }
+
+    // Escribe las páginas actuales en 'path', una por slot de tamaño fijo
+    // (múltiplo de 4 KB) y en el orden de 'pages': con buildFromMTree es el
+    // orden de las hojas del M-tree. Desde entonces las consultas leen de
+    // ese archivo cada página que tenga candidatos.
+    // Slot: int32 count + count × int32 objId, relleno con ceros.
+    bool storePages(const std::string& path) {
+        closePageFile();
+        pagePath = path;
+
+        size_t maxCount = 0;
+        for (const auto& page : pages) maxCount = std::max(maxCount, page.size());
+        pageBytes = (sizeof(int32_t) * (1 + maxCount) + DISK_PAGE - 1) / DISK_PAGE * DISK_PAGE;
+
+        std::ofstream outf(path, std::ios::binary | std::ios::trunc);
+        if (!outf) {
+            std::cerr << "[CPT] storePages: cannot create " << path << "\n";
+            return false;
+        }
+        std::vector<char> slot(pageBytes);
+        for (const auto& page : pages) {
+            std::fill(slot.begin(), slot.end(), 0);
+            int32_t count = (int32_t)page.size();
+            std::memcpy(slot.data(), &count, sizeof(int32_t));
+            for (size_t i = 0; i < page.size(); ++i) {
+                int32_t id = page[i];
+                std::memcpy(slot.data() + sizeof(int32_t) * (1 + i), &id, sizeof(int32_t));
+            }
+            outf.write(slot.data(), (std::streamsize)pageBytes);
+        }
+        outf.close();
+        if (!outf) {
+            std::cerr << "[CPT] storePages: write failed for " << path << "\n";
+            return false;
+        }
+
+        pageFd = ::open(path.c_str(), O_RDONLY);
+        if (pageFd < 0) {
+            std::cerr << "[CPT] storePages: cannot open " << path << "\n";
+            return false;
+        }
+        // el escaneo salta páginas podadas: la lectura anticipada la hacemos nosotros
+        ::posix_fadvise(pageFd, 0, 0, POSIX_FADV_RANDOM);
+        pageBuf.resize(pageBytes);
+        return true;
     }
 
+    // Nº de páginas con candidatos que se piden al kernel (POSIX_FADV_WILLNEED)
+    // por delante de la que se está verificando; 0 = sin lectura anticipada
+    void setPrefetchDepth(int depth) { prefetchDepth = std::max(0, depth); }
+    int  get_prefetchDepth() const   { return prefetchDepth; }
+
     void clear_counters() const {
         compDistQuery = 0;
         pageReads     = 0;
@@ -212,30 +240,26 @@ public:
             }
         }
 
-        // 2. Scan pages in physical order.
-        for (const auto& page : pages) {
-            std::vector<int> candidates;
-            candidates.reserve(page.size());
+        // 2. Lower bound (Lemma 4.1) per object, from the in-memory table.
+        //    Pivots are skipped (already considered).
+        std::vector<double> objLB, pageLB;
+        computeBounds(queryDists, objLB, pageLB,
+                      [&](int objId) { return isPivot[objId]; });
 
-            // Check lower bound (Lemma 4.1) per object in this page.
-            for (int objId : page) {
-                // Skip pivots (already considered).
-                if (isPivot[objId]) continue;
+        // 3. Scan pages in physical order, reading only pages with candidates
+        //    while the next ones are already on their way.
+        ReadAhead ra;
+        for (int p = 0; p < (int)pages.size(); ++p) {
+            if (pageLB[p] > radius) continue;
 
-                double lb = lowerBound(queryDists, objId);
-                if (lb <= radius) {
-                    candidates.push_back(objId);
-                }
-            }
-
-            if (candidates.empty()) {
-                continue;
-            }
-
-            pageReads++;
+            prefetchAhead(ra, p, pageLB, radius, false);
+            const int* ids = readPage(p);
 
             // Compute exact distances only for candidates.
-            for (int objId : candidates) {
+            const size_t base = pageStart[p];
+            for (size_t i = 0; i < pages[p].size(); ++i) {
+                if (objLB[base + i] > radius) continue;
+                int objId = ids[i];
                 double d = db->distance(queryId, objId);
                 compDistQuery++;
                 if (d <= radius) {
@@ -294,31 +318,29 @@ public:
                    ? best.top().dist
                    : std::numeric_limits<double>::infinity();
 
-        // 3. Scan clustered pages in physical order.
-        for (const auto& page : pages) {
-            std::vector<int> candidates;
-            candidates.reserve(page.size());
-
-            // Check lower bound for objects in this page.
-            for (int objId : page) {
-                // Skip objects in pre-scan prefix.
-                if (objId < N0) continue;
-
-                double lb = lowerBound(queryDists, objId);
-                if (best.size() < (size_t)k || lb < tau) {
-                    candidates.push_back(objId);
-                }
-            }
-
-            if (candidates.empty()) {
+        // 3. Lower bounds for the objects outside the pre-scan prefix.
+        std::vector<double> objLB, pageLB;
+        computeBounds(queryDists, objLB, pageLB,
+                      [&](int objId) { return objId < N0; });
+
+        // 4. Scan clustered pages in physical order. tau only shrinks, so a
+        //    page pruned now stays pruned; prefetched pages may still be
+        //    skipped when they come up.
+        ReadAhead ra;
+        for (int p = 0; p < (int)pages.size(); ++p) {
+            if (!(pageLB[p] < tau)) {
                 // Page fully pruned; no I/O.
                 continue;
             }
 
-            pageReads++;
+            prefetchAhead(ra, p, pageLB, tau, true);
+            const int* ids = readPage(p);
 
             // Compute real distances only for candidates.
-            for (int objId : candidates) {
+            const size_t base = pageStart[p];
+            for (size_t i = 0; i < pages[p].size(); ++i) {
+                if (!(objLB[base + i] < tau)) continue;
+                int objId = ids[i];
                 double d = db->distance(queryId, objId);
                 compDistQuery++;
 
@@ -335,7 +357,7 @@ public:
             }
         }
 
-        // 4. Extract results sorted by distance ascending.
+        // 5. Extract results sorted by distance ascending.
         while (!best.empty()) {
             out.push_back(best.top());
             best.pop();
@@ -357,6 +379,21 @@ private:
 
     std::vector<std::vector<int>> pages;
 
+    // Archivo de páginas (storePages); sin él las páginas solo viven en RAM
+    static constexpr size_t DISK_PAGE = 4096;
+    std::string pagePath;
+    int    pageFd    = -1;
+    size_t pageBytes = 0;                 // tamaño de cada slot
+    int    prefetchDepth = 2;
+    std::vector<size_t> pageStart;        // posición del primer objeto de cada página
+    mutable std::vector<char> pageBuf;
+
+    // Páginas pedidas por adelantado que aún no se han verificado
+    struct ReadAhead {
+        std::deque<int> inflight;
+        int next = 0;                     // primera página aún no considerada
+    };
+
     // Default: single page [0..n-1]
     void buildDefaultPages() {
         pages.clear();
@@ -366,6 +403,85 @@ private:
         pages.push_back(std::move(all));
     }
 
+    // Recalcula pageStart y, si hay archivo asociado, lo reescribe. Sin el
+    // archivo las consultas leerían de RAM contando pageReads ficticios.
+    void pagesChanged() {
+        pageStart.resize(pages.size());
+        size_t pos = 0;
+        for (size_t p = 0; p < pages.size(); ++p) {
+            pageStart[p] = pos;
+            pos += pages[p].size();
+        }
+        if (!pagePath.empty() && !storePages(pagePath))
+            throw std::runtime_error("[CPT] cannot store page file " + pagePath);
+    }
+
+    void closePageFile() {
+        if (pageFd >= 0) ::close(pageFd);
+        pageFd = -1;
+    }
+
+    // Cota inferior de cada objeto (en el orden de las páginas) y la mínima
+    // de cada página; los objetos que 'skip' descarta quedan en +inf
+    template <class Skip>
+    void computeBounds(const std::vector<double>& queryDists,
+                       std::vector<double>& objLB, std::vector<double>& pageLB,
+                       Skip skip) const
+    {
+        const double INF = std::numeric_limits<double>::infinity();
+        pageLB.assign(pages.size(), INF);
+        objLB.clear();
+        for (size_t p = 0; p < pages.size(); ++p) {
+            for (int objId : pages[p]) {
+                double lb = skip(objId) ? INF : lowerBound(queryDists, objId);
+                objLB.push_back(lb);
+                pageLB[p] = std::min(pageLB[p], lb);
+            }
+        }
+    }
+
+    // Pide al kernel las siguientes prefetchDepth páginas con candidatos
+    // para 'bound' (lb <= bound, o lb < bound si strict) sin esperar por ellas
+    void prefetchAhead(ReadAhead& ra, int cur, const std::vector<double>& pageLB,
+                       double bound, bool strict) const
+    {
+        if (pageFd < 0 || prefetchDepth == 0) return;
+        while (!ra.inflight.empty() && ra.inflight.front() <= cur)
+            ra.inflight.pop_front();
+
+        int p = std::max(ra.next, cur + 1);
+        while ((int)ra.inflight.size() < prefetchDepth && p < (int)pages.size()) {
+            bool pass = strict ? pageLB[p] < bound : pageLB[p] <= bound;
+            if (pass) {
+                ::posix_fadvise(pageFd, (off_t)p * (off_t)pageBytes,
+                                (off_t)pageBytes, POSIX_FADV_WILLNEED);
+                ra.inflight.push_back(p);
+            }
+            ++p;
+        }
+        ra.next = p;
+    }
+
+    // Lee la página p del archivo (o de RAM si no se asoció ninguno) y cuenta el acceso
+    const int* readPage(int p) const {
+        pageReads++;
+        if (pageFd < 0) {
+            if (!pagePath.empty())
+                throw std::runtime_error("[CPT] page file not open: " + pagePath);
+            return pages[p].data();
+        }
+
+        off_t off = (off_t)p * (off_t)pageBytes;
+        if (::pread(pageFd, pageBuf.data(), pageBytes, off) != (ssize_t)pageBytes)
+            throw std::runtime_error("[CPT] pread failed on " + pagePath);
+
+        int32_t count;
+        std::memcpy(&count, pageBuf.data(), sizeof(int32_t));
+        if (count != (int32_t)pages[p].size())
+            throw std::runtime_error("[CPT] page file out of sync: " + pagePath);
+        return reinterpret_cast<const int*>(pageBuf.data() + sizeof(int32_t));
+    }
+
     // Build full distance table object–pivots.
     void buildDistanceTable() {
         distMatrix.assign(n, std::vector<double>(nPivots));
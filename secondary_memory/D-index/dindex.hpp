@@ -3,6 +3,9 @@
 #include <filesystem>
 #include "../../objectdb.hpp"
 #include "../../datasets/paths.hpp"
+#include "../buffer_pool.hpp"
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 namespace fs = std::filesystem;
@@ -15,57 +18,113 @@ class DIndexRAF {
     static constexpr size_t PAGE_SIZE = 4096; // 4KB físicos
 
     string filename;
-    unordered_map<int, streampos> offsets;
 
     // Páginas físicas únicas tocadas (para todas las consultas)
     mutable unordered_set<uint64_t> pagesVisited;
 
+    // Descriptor abierto durante toda la vida del RAF: las escrituras y
+    // lecturas van con pwrite/pread, sin abrir el archivo en cada objeto
+    int fd = -1;
+    int64_t fileEnd = 0;
+
+    // Lecturas vía buffer pool compartido (opcional)
+    BufferPool* pool = nullptr;
+
+    void openFile() {
+        fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            throw runtime_error("DIndexRAF: cannot open RAF file " + filename);
+        fileEnd = 0;
+    }
+
+    void closeFd() {
+        if (fd < 0) return;
+        if (pool) pool->invalidate(fd);
+        ::close(fd);
+        fd = -1;
+    }
+
+    void writeAt(int64_t off, const void* src, size_t len) {
+        if (pool) {
+            pool->write(fd, off, len, src);
+            return;
+        }
+        if (::pwrite(fd, src, len, (off_t)off) != (ssize_t)len)
+            throw runtime_error("DIndexRAF: write failed");
+    }
+
+    void readAt(int64_t off, void* dst, size_t len) const {
+        if (pool) {
+            pool->read(fd, off, len, dst);
+            return;
+        }
+        if (::pread(fd, dst, len, (off_t)off) != (ssize_t)len)
+            throw runtime_error("DIndexRAF: read failed");
+    }
+
+    void markPages(int64_t off, size_t len) const {
+        uint64_t first = static_cast<uint64_t>(off) / PAGE_SIZE;
+        uint64_t last  = static_cast<uint64_t>(off + (int64_t)len - 1) / PAGE_SIZE;
+        for (uint64_t p = first; p <= last; ++p)
+            pagesVisited.insert(p);
+    }
+
 public:
     explicit DIndexRAF(const string &fname)
         : filename(fname)
     {
         // Crear / truncar archivo
-        ofstream ofs(filename, ios::binary | ios::trunc);
+        openFile();
+    }
+
+    ~DIndexRAF() { closeFd(); }
+
+    DIndexRAF(const DIndexRAF&) = delete;
+    DIndexRAF& operator=(const DIndexRAF&) = delete;
+
+    // El pool debe vivir más que el RAF
+    void attachBufferPool(BufferPool* p) {
+        if (pool && fd >= 0) pool->invalidate(fd);
+        pool = p;
     }
 
     // Para reconstruir el índice (nuevo build)
     void resetFile() {
-        offsets.clear();
+        closeFd();
         pagesVisited.clear();
-        ofstream ofs(filename, ios::binary | ios::trunc);
+        openFile();
     }
 
-    streampos append(int id) {
-        ofstream ofs(filename, ios::binary | ios::app);
-        streampos pos = ofs.tellp();
+    // Bloque de objetos contiguo que empieza en un límite de página y se
+    // rellena hasta la página siguiente (un bucket del D-index).
+    // Devuelve el offset del bloque.
+    int64_t appendBlock(const vector<int>& ids) {
+        int64_t start = fileEnd;
+        if (ids.empty()) return start;
+
+        size_t bytes  = ids.size() * sizeof(int32_t);
+        size_t padded = (bytes + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+        vector<char> buf(padded, 0);
+        for (size_t i = 0; i < ids.size(); ++i) {
+            int32_t v = static_cast<int32_t>(ids[i]);
+            memcpy(buf.data() + i * sizeof(int32_t), &v, sizeof(v));
+        }
+        writeAt(start, buf.data(), padded);
+        fileEnd += static_cast<int64_t>(padded);
+        return start;
+    }
 
-        int32_t v = static_cast<int32_t>(id);
-        ofs.write(reinterpret_cast<const char*>(&v), sizeof(v));
-        ofs.close();
+    // Lee un bloque completo de 'count' objetos con una sola lectura
+    void readBlock(int64_t off, size_t count, vector<int>& out) const {
+        out.clear();
+        if (count == 0) return;
 
-        offsets[id] = pos;
-        return pos;
-    }
+        size_t len = count * sizeof(int32_t);
+        markPages(off, len);
 
-    // Lectura real desde disco: posiciona el puntero, lee el id,
-    // y marca la página física como visitada.
-    void read(int id) const {
-        auto it = offsets.find(id);
-        if (it == offsets.end())
-            throw runtime_error("DIndexRAF: id not found");
-
-        long long off = static_cast<long long>(it->second);
-        uint64_t pageId =
-            static_cast<uint64_t>(off / static_cast<long long>(PAGE_SIZE));
-        pagesVisited.insert(pageId);
-
-        ifstream ifs(filename, ios::binary);
-        if (!ifs)
-            throw runtime_error("DIndexRAF: cannot open RAF file for read");
-
-        ifs.seekg(it->second);
-        int32_t tmp;
-        ifs.read(reinterpret_cast<char*>(&tmp), sizeof(tmp));
+        vector<int32_t> buf(count);
+        readAt(off, buf.data(), len);
+        out.assign(buf.begin(), buf.end());
     }
 
     long long get_pageReads() const {
@@ -100,44 +159,42 @@ inline vector<int> loadHFIPivots(const string &path) {
     return pivs;
 }
 
-inline uint32_t encodeKey(const vector<char>& code) {
-    uint32_t k = 0;
-    for (char c : code) {
-        k *= 3;
-        if (c == 'L')      k += 0;
-        else if (c == 'R') k += 1;
-        else               k += 2;  // '-'
-    }
-    return k;
-}
-
 inline double lbInterval(double q, const pair<double,double>& I) {
     if (q < I.first)  return I.first - q;
     if (q > I.second) return q - I.second;
     return 0.0;
 }
 
+// Bucket en disco: bloque de ids alineado a página dentro del RAF
 struct Bucket {
-    vector<pair<double,double>> intervals; // Intervalos por nivel
-    vector<int> ids;                       // IDs de objetos (0..N-1)
+    vector<pair<double,double>> intervals; // Intervalo por pivote del nivel
+    int64_t offset = -1;                   // inicio del bloque en el RAF
+    size_t  count  = 0;                    // nº de objetos
+};
+
+// Nivel del D-index: función ρ-split formada por m funciones bps
+// (pivote + mediana). Los objetos separables en todos los pivotes van a uno
+// de los 2^m buckets; el resto (conjunto de exclusión) pasa al nivel siguiente.
+struct DIndexLevel {
+    vector<int>    pivotIds;
+    vector<double> medians;
+    vector<Bucket> buckets;                // índice = bits 'R' por pivote
 };
 
 class DIndex {
 private:
     ObjectDB* db;
     int N;
-    size_t L;      // nro de pivotes / niveles
+    size_t H;      // nro de niveles
+    size_t M;      // pivotes por nivel
+    size_t L;      // nro total de pivotes (H * M)
     double rho;
 
     DIndexRAF raf;
 
-    vector<int>    pivotIds;
-    vector<double> pivotMedians;
-
-    vector<double> distMatrix;  // N x L
-
-    vector<Bucket>                 buckets;
-    unordered_map<uint32_t,size_t> bucketIndex;
+    vector<int>         pivotIds;          // L pivotes, M por nivel
+    vector<DIndexLevel> levels;
+    Bucket              exclusion;         // exclusión del último nivel
 
     long long compDist  = 0;
     long long pageReads = 0;
@@ -146,17 +203,18 @@ public:
     DIndex(const string& rafFile,
            ObjectDB* database,
            size_t numLevels,
-           double rho_)
+           double rho_,
+           size_t pivotsPerLevel = 1)
         : db(database),
           N(0),
-          L(numLevels),
+          H(numLevels),
+          M(max<size_t>(1, pivotsPerLevel)),
+          L(numLevels * max<size_t>(1, pivotsPerLevel)),
           rho(rho_),
           raf(rafFile)
     {
         N = db->size();
         pivotIds.resize(L);
-        pivotMedians.resize(L);
-        distMatrix.resize(static_cast<size_t>(N) * L);
     }
 
     //  BUILD
@@ -167,30 +225,31 @@ public:
         cerr << "[DIndex] BUILD START\n";
 
         // Limpieza por si se reconstruye
-        buckets.clear();
-        bucketIndex.clear();
+        levels.clear();
+        exclusion = Bucket();
         clear_counters();    // reseteamos stats globales
 
-        // Reset RAF: truncar archivo y vaciar offsets/páginas
+        // Reset RAF: truncar archivo y vaciar páginas visitadas
         raf.resetFile();
 
         cerr << "[DIndex] Loading HFI pivots if available...\n";
         selectPivots(objects, seed, pivfile);
 
-        cerr << "[DIndex] Computing distance matrix (N x L)...\n";
-        computeDistanceMatrix();
+        // Cada nivel reparte su entrada; la exclusión alimenta al siguiente
+        vector<int> current;
+        current.reserve(objects.size());
+        for (const auto& o : objects) current.push_back(o.id);
 
-        cerr << "[DIndex] Computing medians...\n";
-        computeMedians();
-
-        cerr << "[DIndex] Building buckets...\n";
-        buildBuckets();
-
-        cerr << "[DIndex] Writing objects to RAF...\n";
-        for (const auto& o : objects) {
-            raf.append(o.id);
+        for (size_t lvl = 0; lvl < H; lvl++) {
+            cerr << "[DIndex] Level " << lvl << ": " << current.size() << " objects\n";
+            current = buildLevel(lvl, current);
         }
 
+        exclusion.intervals.clear();
+        exclusion.count  = current.size();
+        exclusion.offset = raf.appendBlock(current);
+
+        cerr << "[DIndex] Exclusion bucket: " << current.size() << " objects\n";
         cerr << "[DIndex] BUILD OK\n";
     }
 
@@ -224,134 +283,127 @@ public:
         }
     }
 
-    void computeDistanceMatrix() {
+    // Construye el nivel lvl sobre 'input' y devuelve su conjunto de exclusión
+    vector<int> buildLevel(size_t lvl, const vector<int>& input) {
+        levels.emplace_back();
+        DIndexLevel& level = levels.back();
+        level.pivotIds.assign(pivotIds.begin() + lvl * M,
+                              pivotIds.begin() + (lvl + 1) * M);
+        level.medians.assign(M, 0.0);
+
         // Distancias de construcción (no se cuentan en las compdist de consultas)
-        for (int id = 0; id < N; id++) {
-            for (size_t j = 0; j < L; j++) {
-                double d = db->distance(id, pivotIds[j]);
-                distMatrix[static_cast<size_t>(id) * L + j] = d;
+        const size_t n = input.size();
+        vector<double> dists(n * M);
+        for (size_t i = 0; i < n; i++)
+            for (size_t j = 0; j < M; j++)
+                dists[i * M + j] = db->distance(input[i], level.pivotIds[j]);
+
+        // Medianas sobre los objetos que llegan a este nivel
+        if (n > 0) {
+            vector<double> tmp(n);
+            for (size_t j = 0; j < M; j++) {
+                for (size_t i = 0; i < n; i++) tmp[i] = dists[i * M + j];
+                nth_element(tmp.begin(), tmp.begin() + n / 2, tmp.end());
+                level.medians[j] = tmp[n / 2];
             }
         }
-    }
-
-    void computeMedians() {
-        vector<double> tmp(static_cast<size_t>(N));
-
-        for (size_t j = 0; j < L; j++) {
-            for (int id = 0; id < N; id++)
-                tmp[static_cast<size_t>(id)] =
-                    distMatrix[static_cast<size_t>(id) * L + j];
-
-            size_t k = static_cast<size_t>(N) / 2;
-            nth_element(tmp.begin(), tmp.begin() + k, tmp.end());
-            pivotMedians[j] = tmp[k];
-        }
-    }
 
-    void buildBuckets() {
-        vector<char> code(L);
-
-        for (int id = 0; id < N; id++) {
-            const double* row =
-                &distMatrix[static_cast<size_t>(id) * L];
-
-            bool assigned = false;
-
-            for (size_t lvl = 0; lvl < L; lvl++) {
-                double d   = row[lvl];
-                double med = pivotMedians[lvl];
-
-                if (d < med - rho) {
-                    fill(code.begin(), code.end(), '-');
-                    code[lvl] = 'L';
-                    addToBucket(id, code);
-                    assigned = true;
-                    break;
-                }
-
-                if (d > med + rho) {
-                    fill(code.begin(), code.end(), '-');
-                    code[lvl] = 'R';
-                    addToBucket(id, code);
-                    assigned = true;
-                    break;
-                }
+        const size_t nBuckets = size_t(1) << M;
+        vector<vector<int>> members(nBuckets);
+        vector<int> excluded;
+
+        for (size_t i = 0; i < n; i++) {
+            size_t code = 0;
+            bool separable = true;
+            for (size_t j = 0; j < M && separable; j++) {
+                double d   = dists[i * M + j];
+                double med = level.medians[j];
+                if (d > med + rho)       code |= size_t(1) << j;   // 'R'
+                else if (d >= med - rho) separable = false;        // '-'
             }
+            if (separable) members[code].push_back(input[i]);
+            else           excluded.push_back(input[i]);
+        }
 
-            if (!assigned) {
-                fill(code.begin(), code.end(), '-');
-                addToBucket(id, code);
+        level.buckets.resize(nBuckets);
+        for (size_t b = 0; b < nBuckets; b++) {
+            Bucket& bk = level.buckets[b];
+            bk.intervals.resize(M);
+            for (size_t j = 0; j < M; j++) {
+                double med = level.medians[j];
+                if (b & (size_t(1) << j))
+                    bk.intervals[j] = {med + rho, numeric_limits<double>::infinity()};
+                else
+                    bk.intervals[j] = {0.0, max(0.0, med - rho)};
             }
+            bk.count  = members[b].size();
+            bk.offset = raf.appendBlock(members[b]);
         }
-    }
 
-    void addToBucket(int id, const vector<char>& code) {
-        uint32_t key = encodeKey(code);
+        return excluded;
+    }
 
-        if (!bucketIndex.count(key)) {
-            size_t idx = buckets.size();
-            bucketIndex[key] = idx;
-            buckets.emplace_back();
-            buildIntervals(buckets.back(), code);
+private:
+    // Distancias de la consulta a los pivotes de cada nivel (cuentan en compDist)
+    vector<vector<double>> queryPivotDists(int qid) {
+        vector<vector<double>> q(levels.size());
+        for (size_t lvl = 0; lvl < levels.size(); lvl++) {
+            for (int p : levels[lvl].pivotIds) {
+                q[lvl].push_back(db->distance(qid, p));
+                compDist++;
+            }
         }
-
-        buckets[bucketIndex[key]].ids.push_back(id);
+        return q;
     }
 
-    void buildIntervals(Bucket& b, const vector<char>& code) {
-        b.intervals.resize(L);
-
-        for (size_t lvl = 0; lvl < L; lvl++) {
-            double med = pivotMedians[lvl];
+    double bucketLB(const Bucket& b, const vector<double>& q) const {
+        double LB = 0.0;
+        for (size_t j = 0; j < b.intervals.size(); j++)
+            LB = max(LB, lbInterval(q[j], b.intervals[j]));
+        return LB;
+    }
 
-            if (code[lvl] == 'L') {
-                b.intervals[lvl] = {0.0, max(0.0, med - rho)};
-            }
-            else if (code[lvl] == 'R') {
-                b.intervals[lvl] = {med + rho,
-                                    numeric_limits<double>::infinity()};
-            }
-            else {
-                b.intervals[lvl] = {max(0.0, med - rho), med + rho};
-            }
+    // Cota de los objetos excluidos del nivel: están en la zona
+    // [med-ρ, med+ρ] de al menos uno de sus pivotes
+    double exclusionLB(const DIndexLevel& level, const vector<double>& q) const {
+        double LB = numeric_limits<double>::infinity();
+        for (size_t j = 0; j < level.medians.size(); j++) {
+            double med = level.medians[j];
+            LB = min(LB, lbInterval(q[j], {max(0.0, med - rho), med + rho}));
         }
+        return LB;
     }
 
-private:
     vector<pair<int,double>> MRQ_withDists(int qid, double r) {
-        vector<double> q(L);
-
-        // Distancias query -> pivotes (cuentan en compDist)
-        for (size_t i = 0; i < L; i++) {
-            q[i] = db->distance(qid, pivotIds[i]);
-            compDist++;
-        }
+        auto q = queryPivotDists(qid);
 
         vector<pair<int,double>> out;
+        vector<int> bucketObjs;
 
-        for (auto &b : buckets) {
-            double LB = 0.0;
-
-            for (size_t lvl = 0; lvl < L; lvl++) {
-                LB = max(LB, lbInterval(q[lvl], b.intervals[lvl]));
-                if (LB > r) break;
-            }
-
-            if (LB > r) continue;
-
-            // Buckets candidatos -> verificar objetos
-            for (int id : b.ids) {
-                // Leer del RAF
-                raf.read(id);
-
+        auto scan = [&](const Bucket& b) {
+            raf.readBlock(b.offset, b.count, bucketObjs);
+            for (int id : bucketObjs) {
                 // Distancia real (cuenta en compDist)
                 double d = db->distance(qid, id);
                 compDist++;
                 if (d <= r)
                     out.push_back({id, d});
             }
+        };
+
+        // Con r <= ρ la bola de la consulta corta a lo sumo un bucket
+        // separable por nivel; si no alcanza la zona de exclusión de un
+        // nivel, los niveles siguientes (y la exclusión final) se descartan
+        for (size_t lvl = 0; lvl < levels.size(); lvl++) {
+            const DIndexLevel& level = levels[lvl];
+            for (const Bucket& b : level.buckets) {
+                if (b.count == 0 || bucketLB(b, q[lvl]) > r) continue;
+                scan(b);
+            }
+            if (exclusionLB(level, q[lvl]) > r) return out;
         }
 
+        if (exclusion.count > 0) scan(exclusion);
         return out;
     }
 
@@ -373,43 +425,69 @@ public:
         return out;
     }
 
-    
+    // kNN incremental: los buckets de todos los niveles se visitan en orden
+    // de cota inferior y cada objeto se evalúa una sola vez. La cota de un
+    // bucket del nivel i incluye la de exclusión de los niveles anteriores.
+    // Termina cuando la cota del siguiente bucket ya no mejora al k-ésimo
+    // vecino actual.
     vector<pair<int,double>> MkNN(int qid, size_t k) {
         // Snapshot antes de todo el proceso MkNN
         long long comp_before  = compDist;
         long long pages_before = raf.get_pageReads();
 
-        double R = rho;                     // radio inicial (paper: r_0)
-        vector<pair<int,double>> best;      // mejores candidatos actuales
-
-        const int MAX_ITERS = 10;           // límite de refinamientos
+        vector<pair<int,double>> best;      // (id, dist)
+        if (k == 0 || levels.empty()) {
+            pageReads = 0;
+            return best;
+        }
 
-        for (int iter = 0; iter < MAX_ITERS; ++iter) {
-            auto cand = MRQ_withDists(qid, R);  // ya suma compDist y RAF pages
+        auto q = queryPivotDists(qid);
 
-            if (cand.empty()) {
-                // nada dentro de R: agrandamos el radio agresivamente
-                R *= 2.0;
-                continue;
+        // Buckets ordenados por cota inferior
+        vector<pair<double,const Bucket*>> order;
+        double excl = 0.0;   // cota de estar excluido en todos los niveles previos
+        for (size_t lvl = 0; lvl < levels.size(); lvl++) {
+            for (const Bucket& b : levels[lvl].buckets) {
+                if (b.count == 0) continue;
+                order.push_back({max(excl, bucketLB(b, q[lvl])), &b});
             }
+            excl = max(excl, exclusionLB(levels[lvl], q[lvl]));
+        }
+        if (exclusion.count > 0) order.push_back({excl, &exclusion});
 
-            // Ordenamos por distancia
-            sort(cand.begin(), cand.end(),
-                 [](auto &a, auto &b){ return a.second < b.second; });
+        sort(order.begin(), order.end(),
+             [](const auto& a, const auto& b) { return a.first < b.first; });
 
-            if (cand.size() >= k) {
-                // Ya tenemos al menos k vecinos dentro de R
-                best.assign(cand.begin(), cand.begin() + k);
-                break;
-            } else {
-                // Aún no llegamos a k: guardamos lo mejor y ampliamos el radio
-                best = cand;
+        // Max-heap por distancia con los k mejores
+        auto cmp = [](const pair<int,double>& a, const pair<int,double>& b) {
+            return a.second < b.second;
+        };
+        priority_queue<pair<int,double>, vector<pair<int,double>>, decltype(cmp)> heap(cmp);
 
-                double far = cand.back().second;
-                R = max(R * 2.0, far * 2.0);
+        vector<int> bucketObjs;
+        for (const auto& [LB, b] : order) {
+            if (heap.size() == k && LB >= heap.top().second) break;
+
+            raf.readBlock(b->offset, b->count, bucketObjs);
+            for (int id : bucketObjs) {
+                double d = db->distance(qid, id);
+                compDist++;
+                if (heap.size() < k) {
+                    heap.push({id, d});
+                } else if (d < heap.top().second) {
+                    heap.pop();
+                    heap.push({id, d});
+                }
             }
         }
 
+        best.reserve(heap.size());
+        while (!heap.empty()) {
+            best.push_back(heap.top());
+            heap.pop();
+        }
+        reverse(best.begin(), best.end());
+
         // Stats = delta consumido solo en esta MkNN
         compDist  = compDist  - comp_before;
         pageReads = raf.get_pageReads() - pages_before;
@@ -420,6 +498,9 @@ public:
     long long get_compDist() const { return compDist; }
     long long get_pageReads() const { return pageReads; }
 
+    // Lecturas del RAF a través de un buffer pool compartido (nullptr = pread)
+    void attachBufferPool(BufferPool* pool) { raf.attachBufferPool(pool); }
+
     void clear_counters() {
         compDist  = 0;
         pageReads = 0;
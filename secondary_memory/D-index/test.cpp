@@ -1,5 +1,6 @@
 #include <bits/stdc++.h>
 #include "dindex.hpp"
+#include "../buffer_pool.hpp"
 #include "../../objectdb.hpp"
 #include "../../datasets/paths.hpp"
 
@@ -19,6 +20,10 @@ static const vector<int> K_VALUES = {
 
 static const vector<string> DATASETS = {"LA"};
 
+// Buffer pool compartido: presupuesto en páginas de 4KB (0 = sin caché)
+static const size_t BUFFER_POOL_PAGES = 1024;
+static const BufferPool::Policy BUFFER_POOL_POLICY = BufferPool::Policy::LRU;
+
 int main(int argc, char** argv) {
     srand(12345);
 
@@ -76,16 +81,21 @@ int main(int argc, char** argv) {
         J << "[\n";
         bool firstOutput = true;
 
-        const int    numLevels = 5;   // l=5 para índices en disco
-        const double rho       = 5.0;
+        const int    numLevels      = 5;   // l=5 para índices en disco
+        const int    pivotsPerLevel = 1;   // funciones bps por nivel (2^m buckets)
+        const double rho            = 5.0;
 
         cerr << "[BUILD] Construyendo D-index (l=" << numLevels
              << ", rho=" << rho << ") con pivotes HFI.\n";
 
         string rafFile = "dindex_indexes/" + dataset + "_raf.bin";
-        string hfiFile = path_pivots(dataset, numLevels);
+        string hfiFile = path_pivots(dataset, numLevels * pivotsPerLevel);
+
+        // caché caliente a lo largo de todas las consultas del dataset
+        // (declarado antes del índice: debe sobrevivirlo)
+        BufferPool pool(BUFFER_POOL_PAGES, 4096, BUFFER_POOL_POLICY);
 
-        DIndex dindex(rafFile, db.get(), numLevels, rho);
+        DIndex dindex(rafFile, db.get(), numLevels, rho, pivotsPerLevel);
 
         vector<DataObject> allObjects;
         allObjects.reserve(db->size());
@@ -101,6 +111,8 @@ int main(int argc, char** argv) {
         dindex.build(allObjects, 42, hfiFile);
         cerr << "[BUILD] OK.\n";
 
+        dindex.attachBufferPool(&pool);
+
         cerr << "\n[MRQ] Ejecutando selectividades.\n";
 
         for (double sel : SELECTIVITIES) {
@@ -111,6 +123,7 @@ int main(int argc, char** argv) {
 
             long long totalD = 0;
             long long totalP = 0;
+            pool.reset_stats();
 
             auto start_all = chrono::high_resolution_clock::now();
 
@@ -152,6 +165,10 @@ int main(int argc, char** argv) {
               << "\"compdists\":" << avgD << ","
               << "\"time_ms\":" << avgTms << ","
               << "\"pages\":" << avgPg << ","
+              << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+              << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+              << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+              << "\"hit_rate\":" << pool.get_hitRate() << ","
               << "\"n_queries\":" << queries.size() << ","
               << "\"run_id\":1"
               << "}";
@@ -164,6 +181,7 @@ int main(int argc, char** argv) {
 
             long long totalD = 0;
             long long totalP = 0;
+            pool.reset_stats();
 
             auto start_all = chrono::high_resolution_clock::now();
 
@@ -203,6 +221,10 @@ int main(int argc, char** argv) {
               << "\"compdists\":" << avgD << ","
               << "\"time_ms\":" << avgTms << ","
               << "\"pages\":" << avgPg << ","
+              << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+              << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+              << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+              << "\"hit_rate\":" << pool.get_hitRate() << ","
               << "\"n_queries\":" << queries.size() << ","
               << "\"run_id\":1"
               << "}";
@@ -2,6 +2,7 @@
 #define EGNAT_DISK_HPP
 
 #include "../../objectdb.hpp"
+#include "../buffer_pool.hpp"
 #include <vector>
 #include <queue>
 #include <random>
@@ -61,6 +62,7 @@ private:
     // Archivos
     std::string leafPath;
     mutable FILE* leafFp = nullptr;
+    BufferPool* pool = nullptr;
 
     // Métricas
     mutable long long compDist = 0;
@@ -83,9 +85,14 @@ public:
 
 
     ~EGNAT_Disk() {
-        if (leafFp) fclose(leafFp);
+        closeLeaves();
     }
 
+    // Lecturas de hojas a través de un buffer pool compartido (nullptr = lectura directa).
+    // Los nodos internos ya residen en RAM; el pool solo cachea páginas de .egn_leaf.
+    // El pool debe vivir más que el índice.
+    void attachBufferPool(BufferPool* pool_) { pool = pool_; }
+
     void clear_counters() const {
         compDist = pageReads = queryTime = 0;
     }
@@ -163,6 +170,7 @@ public:
         pageWrites += (long long)nodes.size() * pagesPerNode;
 
         // abrir archivo de hojas para queries
+        closeLeaves();
         leafFp = std::fopen(leafPath.c_str(),"rb");
         if (!leafFp) throw std::runtime_error("cannot reopen leaves");
 
@@ -172,6 +180,26 @@ public:
     }
 
 private:
+    void closeLeaves() {
+        if (!leafFp) return;
+        if (pool) pool->invalidate(fileno(leafFp));
+        std::fclose(leafFp);
+        leafFp = nullptr;
+    }
+
+    // Lee las entradas de una hoja (L.count entradas contiguas en .egn_leaf)
+    void readLeaf(const LeafInfo& L, std::vector<LeafEntry>& buf) const {
+        buf.resize(L.count);
+        int64_t off = (int64_t)L.offset * (int64_t)sizeof(LeafEntry);
+        if (pool) {
+            pool->read(fileno(leafFp), off, buf.size() * sizeof(LeafEntry), buf.data());
+            return;
+        }
+        std::fseek(leafFp, off, SEEK_SET);
+        size_t _nread = std::fread(buf.data(), sizeof(LeafEntry), L.count, leafFp);
+        (void)_nread;
+    }
+
     int buildNode(const std::vector<int>& objs, int parentPivot) {
         if ((int)objs.size() <= leafCap) {
             LeafInfo L;
@@ -291,13 +319,8 @@ private:
             if (L.parentPivot>=0)
                 dqp = distObj(q, L.parentPivot);
 
-            std::vector<LeafEntry> buf(L.count);
-            int64_t off = (int64_t)L.offset * (int64_t)sizeof(LeafEntry);
-
-            std::fseek(leafFp, off, SEEK_SET);
-            //std::fread(buf.data(), sizeof(LeafEntry), L.count, leafFp);
-            size_t _nread = std::fread(buf.data(), sizeof(LeafEntry), L.count, leafFp);
-            (void)_nread;
+            std::vector<LeafEntry> buf;
+            readLeaf(L, buf);
 
 
             for (auto& e : buf) {
@@ -370,12 +393,8 @@ private:
 
             double dqp = (L.parentPivot<0)?0.0:distObj(q, L.parentPivot);
 
-            std::vector<LeafEntry> buf(L.count);
-            int64_t off = (int64_t)L.offset * (int64_t)sizeof(LeafEntry);
-            std::fseek(leafFp, off, SEEK_SET);
-            //std::fread(buf.data(), sizeof(LeafEntry), L.count, leafFp);
-            size_t _nread2 = std::fread(buf.data(), sizeof(LeafEntry), L.count, leafFp);
-            (void)_nread2;
+            std::vector<LeafEntry> buf;
+            readLeaf(L, buf);
 
 
             for (auto& e : buf) {
@@ -1,5 +1,6 @@
 #include <bits/stdc++.h>
 #include "egnat.hpp"                
+#include "../buffer_pool.hpp"
 #include "../../objectdb.hpp"
 #include "../../datasets/paths.hpp"
 
@@ -15,6 +16,10 @@ static const vector<int> K_VALUES = {5, 10, 20, 50, 100};
 // static const vector<string> DATASETS = {"LA", "Words", "Color", "Synthetic"};
 static const vector<string> DATASETS = {"LA"};
 
+// Buffer pool compartido: presupuesto en páginas de 4KB (0 = sin caché)
+static const size_t BUFFER_POOL_PAGES = 1024;
+static const BufferPool::Policy BUFFER_POOL_POLICY = BufferPool::Policy::LRU;
+
 int main(int argc, char** argv) {
     srand(12345);
     vector<string> datasets;
@@ -74,6 +79,10 @@ int main(int argc, char** argv) {
         // aridad GNAT = 5
         int m = 5;
 
+        // caché caliente a lo largo de todas las consultas del dataset
+        // (declarado antes del índice: debe sobrevivirlo)
+        BufferPool pool(BUFFER_POOL_PAGES, 4096, BUFFER_POOL_POLICY);
+
         // ---- Crear EGNAT ----
         EGNAT_Disk egn(db.get(), m, pageBytes);
 
@@ -81,6 +90,7 @@ int main(int argc, char** argv) {
 
         // ---- Build físico ----
         egn.build(base);        // crea base.egn_index + base.egn_leaf
+        egn.attachBufferPool(&pool);
 
         // MRQ
         for (double sel : SELECTIVITIES) {
@@ -88,6 +98,7 @@ int main(int argc, char** argv) {
 
             double R = radii[sel];
             long long totalD = 0, totalT = 0, totalPages = 0;
+            pool.reset_stats();
 
             for (int q : queries) {
                 vector<int> out;
@@ -121,6 +132,10 @@ int main(int argc, char** argv) {
               << "\"compdists\":" << avgD << ","
               << "\"time_ms\":" << avgTms << ","
               << "\"pages\":" << avgPA << ","
+              << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+              << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+              << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+              << "\"hit_rate\":" << pool.get_hitRate() << ","
               << "\"n_queries\":" << queries.size() << ","
               << "\"run_id\":1"
               << "}";
@@ -129,6 +144,7 @@ int main(int argc, char** argv) {
         // MkNN
         for (int k : K_VALUES) {
             long long totalD = 0, totalT = 0, totalPages = 0;
+            pool.reset_stats();
 
             for (int q : queries) {
                 vector<pair<double,int>> out;
@@ -162,6 +178,10 @@ int main(int argc, char** argv) {
               << "\"compdists\":" << avgD << ","
               << "\"time_ms\":" << avgTms << ","
               << "\"pages\":" << avgPA << ","
+              << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+              << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+              << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+              << "\"hit_rate\":" << pool.get_hitRate() << ","
               << "\"n_queries\":" << queries.size() << ","
               << "\"run_id\":1"
               << "}";
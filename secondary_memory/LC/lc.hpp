@@ -2,6 +2,7 @@
 #define LC_DISK_HPP
 
 #include "../../objectdb.hpp"
+#include "../buffer_pool.hpp"
 #include <vector>
 #include <set>
 #include <queue>
@@ -51,6 +52,7 @@ private:
     std::string indexPath;
     std::string nodePath;
     mutable FILE* nodeFp = nullptr;    // solo se usa en restore + queries
+    BufferPool* pool = nullptr;        // caché de páginas de base.lc_node (opcional)
 
 public:
     LC_Disk(const ObjectDB* db_, int pageBytes_ = 4096)
@@ -71,12 +73,13 @@ public:
     }
 
     ~LC_Disk() {
-        if (nodeFp) {
-            std::fclose(nodeFp);
-            nodeFp = nullptr;
-        }
+        closeNodeFile();
     }
 
+    // Lecturas de clusters a través de un buffer pool compartido (nullptr = lectura directa).
+    // El pool debe vivir más que el índice.
+    void attachBufferPool(BufferPool* pool_) { pool = pool_; }
+
     void clear_counters() const {
         compDist   = 0;
         pageReads  = 0;
@@ -226,10 +229,7 @@ public:
         idxIn.close();
 
         // Abrir archivo de nodos para lecturas
-        if (nodeFp) {
-            std::fclose(nodeFp);
-            nodeFp = nullptr;
-        }
+        closeNodeFile();
         nodeFp = std::fopen(nodePath.c_str(), "rb");
         if (!nodeFp) {
             throw std::runtime_error("[LC_Disk] No se pudo abrir " + nodePath);
@@ -268,16 +268,7 @@ public:
                 continue;
 
             // leer miembros desde disco
-            buffer.resize(c.count);
-            std::int64_t byteOffset = (std::int64_t)c.offset * (std::int64_t)sizeof(int32_t);
-
-            if (std::fseek(nodeFp, byteOffset, SEEK_SET) != 0) {
-                throw std::runtime_error("[LC_Disk] fseek falló en rangeSearch");
-            }
-            size_t nRead = std::fread(buffer.data(), sizeof(int32_t), c.count, nodeFp);
-            if (nRead != (size_t)c.count) {
-                throw std::runtime_error("[LC_Disk] fread incompleto en rangeSearch");
-            }
+            readMembers(c, buffer);
 
             // chequear miembros
             for (int i = 0; i < c.count; ++i) {
@@ -321,16 +312,7 @@ public:
             if ((int)pq.size() > k) pq.pop();
 
             if (c.count > 0) {
-                buffer.resize(c.count);
-                std::int64_t byteOffset = (std::int64_t)c.offset * (std::int64_t)sizeof(int32_t);
-
-                if (std::fseek(nodeFp, byteOffset, SEEK_SET) != 0) {
-                    throw std::runtime_error("[LC_Disk] fseek falló en knnSearch");
-                }
-                size_t nRead = std::fread(buffer.data(), sizeof(int32_t), c.count, nodeFp);
-                if (nRead != (size_t)c.count) {
-                    throw std::runtime_error("[LC_Disk] fread incompleto en knnSearch");
-                }
+                readMembers(c, buffer);
 
                 for (int i = 0; i < c.count; ++i) {
                     int id = buffer[i];
@@ -358,6 +340,32 @@ private:
         compDist++;
         return db->distance(a, b);
     }
+
+    void closeNodeFile() {
+        if (!nodeFp) return;
+        if (pool) pool->invalidate(fileno(nodeFp));
+        std::fclose(nodeFp);
+        nodeFp = nullptr;
+    }
+
+    // Lee los IDs de los miembros de un cluster desde base.lc_node
+    void readMembers(const ClusterInfo& c, std::vector<int32_t>& buffer) const {
+        buffer.resize(c.count);
+        std::int64_t byteOffset = (std::int64_t)c.offset * (std::int64_t)sizeof(int32_t);
+
+        if (pool) {
+            pool->read(fileno(nodeFp), byteOffset, buffer.size() * sizeof(int32_t), buffer.data());
+            return;
+        }
+
+        if (std::fseek(nodeFp, byteOffset, SEEK_SET) != 0) {
+            throw std::runtime_error("[LC_Disk] fseek falló al leer cluster");
+        }
+        size_t nRead = std::fread(buffer.data(), sizeof(int32_t), c.count, nodeFp);
+        if (nRead != (size_t)c.count) {
+            throw std::runtime_error("[LC_Disk] fread incompleto al leer cluster");
+        }
+    }
 };
 
 #endif // LC_DISK_HPP
@@ -1,5 +1,6 @@
 #include <bits/stdc++.h>
 #include "lc.hpp"
+#include "../buffer_pool.hpp"
 #include "../../objectdb.hpp"
 #include "../../datasets/paths.hpp"
 
@@ -15,6 +16,10 @@ static const vector<int> K_VALUES = {5, 10, 20, 50, 100};
 // static const vector<string> DATASETS = {"LA", "Words", "Color", "Synthetic"};
 static const vector<string> DATASETS = {"LA"};
 
+// Buffer pool compartido: presupuesto en páginas de 4KB (0 = sin caché)
+static const size_t BUFFER_POOL_PAGES = 1024;
+static const BufferPool::Policy BUFFER_POOL_POLICY = BufferPool::Policy::LRU;
+
 int main(int argc, char** argv) {
     srand(12345);
     vector<string> datasets;
@@ -70,11 +75,16 @@ int main(int argc, char** argv) {
         int pageBytes = (dataset == "Color" || dataset == "Synthetic") ?
                         40960 : 4096;
 
+        // caché caliente a lo largo de todas las consultas del dataset
+        // (declarado antes del índice: debe sobrevivirlo)
+        BufferPool pool(BUFFER_POOL_PAGES, 4096, BUFFER_POOL_POLICY);
+
         LC_Disk lc(db.get(), pageBytes);
 
         string base = "lc_indexes/" + dataset;
         lc.build(base);      // escribe en disco: base.lc_index y base.lc_node
         lc.restore(base);    // abre base.lc_node y carga base.lc_index
+        lc.attachBufferPool(&pool);
 
         int numClusters = lc.get_num_clusters();
 
@@ -84,6 +94,7 @@ int main(int argc, char** argv) {
 
             double R = radii[sel];
             long long totalD = 0, totalT = 0, totalPages = 0;
+            pool.reset_stats();
 
             for (int q : queries) {
                 vector<int> out;
@@ -117,6 +128,10 @@ int main(int argc, char** argv) {
               << "\"compdists\":" << avgD << ","
               << "\"time_ms\":" << avgTms << ","
               << "\"pages\":" << avgPA << ","
+              << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+              << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+              << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+              << "\"hit_rate\":" << pool.get_hitRate() << ","
               << "\"n_queries\":" << queries.size() << ","
               << "\"run_id\":1"
               << "}";
@@ -125,6 +140,7 @@ int main(int argc, char** argv) {
         // MkNN
         for (int k : K_VALUES) {
             long long totalD = 0, totalT = 0, totalPages = 0;
+            pool.reset_stats();
 
             for (int q : queries) {
                 vector<pair<double,int>> out;
@@ -158,6 +174,10 @@ int main(int argc, char** argv) {
               << "\"compdists\":" << avgD << ","
               << "\"time_ms\":" << avgTms << ","
               << "\"pages\":" << avgPA << ","
+              << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+              << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+              << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+              << "\"hit_rate\":" << pool.get_hitRate() << ","
               << "\"n_queries\":" << queries.size() << ","
               << "\"run_id\":1"
               << "}";
@@ -2,6 +2,7 @@
 #define MTREE_DISK_HPP
 
 #include "../../objectdb.hpp"
+#include "../buffer_pool.hpp"
 
 #include <vector>
 #include <queue>
@@ -12,32 +13,110 @@
 #include <stdexcept>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <string>
 #include <iostream>
+#include <random>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 class MTree_Disk {
 public:
     
     // to evaluate and compare queries 
     mutable long long compDist   = 0;  // # distancias
-    mutable long long pageReads  = 0;  // páginas (nodos) leídos
-    mutable long long pageWrites = 0;  // páginas (nodos) escritos en build
+    mutable long long pageReads  = 0;  // páginas físicas leídas (pagesPerNode por nodo)
+    mutable long long pageWrites = 0;  // páginas físicas escritas en build / insert
     mutable long long queryTime  = 0;  // tiempo acumulado en µs (solo queries)
 
+    // ---- Formato en disco (paginado) ----
+    //  página 0            : FileHeader
+    //  páginas 1, 1+P, ... : un nodo cada P = pagesPerNode páginas alineadas,
+    //                        NodeHeader + count entradas EntryDisk empaquetadas
+    // Cada nodo se lee con un único pread de pagesPerNode * pageSize bytes.
+    //
+    // Entradas compactas (v2, 16 B): radius y parentDist en float32 y el hijo
+    // como nº de página. radius se redondea hacia arriba; parentDist al más
+    // cercano, y el parent filtering suma un ulp de holgura (parentSlack):
+    // las cotas siguen siendo conservadoras.
+#pragma pack(push, 1)
+    struct EntryDisk 
+    {
+        int32_t  objId;
+        float    radius;
+        float    parentDist;
+        uint32_t childPage;  // 0 en hojas (la página 0 es el header)
+    };
+
+    struct NodeHeader
+    {
+        uint8_t isLeaf;
+        uint8_t pad[3];
+        int32_t count;
+    };
+#pragma pack(pop)
 
-    explicit MTree_Disk(const ObjectDB* db_, int nodeCapacity_ = 64)
+    struct FileHeader
+    {
+        char     magic[8];      // "MTREEPG"
+        uint32_t version;
+        uint32_t pageSize;      // bytes por página
+        uint32_t pagesPerNode;  // páginas que ocupa cada nodo
+        uint32_t nodeCapacity;  // máx entradas por nodo
+        int64_t  rootOffset;    // offset en bytes del nodo raíz
+        int64_t  nodeCount;     // nodos escritos
+    };
+
+    // Entrada decodificada en RAM (insert, PM-tree / CPT vía loadAllNodes)
+    struct Entry
+    {
+        int32_t objId;
+        double  radius;
+        double  parentDist;
+        int64_t childOffset; // -1 en hojas
+    };
+
+    static constexpr int ENTRY_BYTES       = (int)sizeof(EntryDisk);   // 16
+    static constexpr int NODE_HEADER_BYTES = (int)sizeof(NodeHeader);  // 8
+    static constexpr uint32_t FORMAT_VERSION = 2;  // v1: entradas de 28 B (double / int64)
+
+    // Política de promoción de routing objects al dividir un nodo (insert)
+    //  MM_RAD   : par que minimiza el mayor de los dos radios (todos los pares)
+    //  RANDOM   : par aleatorio
+    //  SAMPLING : mejor par según mM_RAD entre 'samples' pares aleatorios
+    enum class Promotion { MM_RAD, RANDOM, SAMPLING };
+
+    // Nodo completo tal como lo ven PM-tree / CPT al recorrer el archivo
+    struct RawNode
+    {
+        bool isLeaf;
+        int64_t offset;
+        std::vector<Entry> entries;
+    };
+
+
+    explicit MTree_Disk(const ObjectDB* db_, int nodeCapacity_ = 64, int pageSize_ = 4096)
         : db(db_), n(db_ ? db_->size() : 0),
           nodeCapacity(std::max(4, nodeCapacity_)),
           leafCapacity(std::max(4, nodeCapacity_)),
-          fpIndex(nullptr),
+          pageSize(std::max(NODE_HEADER_BYTES + ENTRY_BYTES, pageSize_)),
+          pagesPerNode(pagesFor(std::max(nodeCapacity, leafCapacity), pageSize)),
+          fd(-1),
           rootOffset(-1)
     {}
 
     ~MTree_Disk() 
     {
-        if (fpIndex) {
-            std::fclose(fpIndex);
-            fpIndex = nullptr;
-        }
+        closeIndex();
+    }
+
+    // Entradas que caben en un nodo de pageBytes bytes
+    static int capacityForPage(int pageBytes)
+    {
+        return std::max(4, (pageBytes - NODE_HEADER_BYTES) / ENTRY_BYTES);
     }
 
     void clear_counters() const 
@@ -51,189 +130,388 @@ public:
     long long get_pageWrites() const { return pageWrites; }
     long long get_queryTime()  const { return queryTime;  }
 
-    
+    int get_pageSize()     const { return pageSize;     }
+    int get_pagesPerNode() const { return pagesPerNode; }
+
+    // Slim-down tras el bulk-loading: hasta 'rounds' pasadas por nodo (0 = desactivado)
+    void setSlimDown(int rounds = 3) { slimRounds = std::max(0, rounds); }
+    long long get_slimMoves() const { return slimMoves; }
+
+    void setPromotion(Promotion p, int samples = 10) {
+        promotion    = p;
+        promoSamples = std::max(1, samples);
+    }
+
+    // Lecturas de nodos a través de un buffer pool compartido (nullptr = pread directo).
+    // El pool debe vivir más que el índice.
+    void attachBufferPool(BufferPool* pool_) { pool = pool_; }
+
+    // Fija en el pool los nodos de los 'levels' niveles superiores (raíz = nivel 1).
+    // Devuelve el número de nodos fijados; se detiene si el pool se llena.
+    int pinUpperLevels(int levels) const {
+        if (!pool || mapBase) return 0;
+        return forEachUpperNode(levels, [&](int64_t off) {
+            return pool->pin(fd, off, nodeBytes());
+        });
+    }
 
     
-    void build(const std::string& basePath) {
+    // Bulk-loading sobre los objetos [0, count) de db (count < 0: todos);
+    // el resto puede añadirse después con insert()
+    void build(const std::string& basePath, int count = -1) {
         if (!db) throw std::runtime_error("[MTree_Disk] db == nullptr");
+        if (count >= 0) n = std::min(count, db->size());
 
         indexPath = basePath + ".mtree_index";
 
-        fpIndex = std::fopen(indexPath.c_str(), "wb+");
-        if (!fpIndex)
+        closeIndex();
+        fd = ::open(indexPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
             throw std::runtime_error("[MTree_Disk] No se pudo crear " + indexPath);
 
         pageWrites = 0;
-
-        // placeholder <> offset
-        int64_t placeholder = -1;
-        std::fwrite(&placeholder, sizeof(int64_t), 1, fpIndex);
+        nodeCount  = 0;
+        nodeBuf.assign(nodeBytes(), 0);
 
         std::vector<int> objs(n);
         for (int i = 0; i < n; ++i) objs[i] = i;
 
         NodeRAM* rootRAM = build_recursive(objs, -1);
 
-        // post-order save
+        slimMoves = 0;
+        if (slimRounds > 0) slimDown(rootRAM);
+
+        // post-order save (página 0 reservada para el header)
         rootOffset = writeNodeRec(rootRAM);
 
-        // real offset (from root) in the header
-        std::fflush(fpIndex);
-        std::fseek(fpIndex, 0, SEEK_SET);
-        std::fwrite(&rootOffset, sizeof(int64_t), 1, fpIndex);
-        std::fflush(fpIndex);
+        // header con el offset real de la raíz
+        writeHeader();
 
         // Free RAM
         freeTree(rootRAM);
 
-        std::fclose(fpIndex);
-        fpIndex = nullptr;
+        closeIndex();
     }
 
     // load an existing index and load 'rootOffset'
-    void restore(const std::string& basePath) {
+    // writable = true abre el archivo en lectura/escritura para insert()
+    void restore(const std::string& basePath, bool writable = false) {
         indexPath = basePath + ".mtree_index";
 
-        if (fpIndex) {
-            std::fclose(fpIndex);
-            fpIndex = nullptr;
-        }
-
-        fpIndex = std::fopen(indexPath.c_str(), "rb");
-        if (!fpIndex)
+        closeIndex();
+        fd = ::open(indexPath.c_str(), writable ? O_RDWR : O_RDONLY);
+        if (fd < 0)
             throw std::runtime_error("[MTree_Disk] No se pudo abrir " + indexPath);
 
-        if (std::fread(&rootOffset, sizeof(int64_t), 1, fpIndex) != 1) {
-            std::fclose(fpIndex);
-            fpIndex = nullptr;
-            throw std::runtime_error("[MTree_Disk] Archivo corrupto (no rootOffset)");
+        FileHeader h;
+        if (!readHeader(fd, h) || h.version != FORMAT_VERSION) {
+            ::close(fd);
+            fd = -1;
+            throw std::runtime_error("[MTree_Disk] Archivo corrupto o en formato antiguo (reconstruir con build): " + indexPath);
         }
 
+        // el archivo manda: la geometría de página es la usada al construir
+        pageSize     = (int)h.pageSize;
+        pagesPerNode = (int)h.pagesPerNode;
+        nodeCapacity = leafCapacity = (int)h.nodeCapacity;
+        rootOffset   = h.rootOffset;
+        nodeCount    = h.nodeCount;
+        isWritable   = writable;
+        nodeBuf.assign(nodeBytes(), 0);
+
         if (rootOffset < 0)
             std::cerr << "[MTree_Disk] Advertencia: rootOffset < 0\n";
     }
 
-    // MRQ: Range (Lemma 4.2)
-    void rangeSearch(int qId, double R, std::vector<int>& out) const 
-    {
-        using clock = std::chrono::high_resolution_clock;
-        auto t0 = clock::now();
-
-        out.clear();
-        if (!fpIndex)
-            throw std::runtime_error("[MTree_Disk] rangeSearch: fpIndex==nullptr (¿faltó restore?)");
-        if (rootOffset < 0) return; // índice vacío
-
-        // DFS + Lemma 4.2 + parent filtering
-        dfs_range(rootOffset, -1, 0.0, qId, R, out);
+    // Modo de servicio de solo lectura: mapea el .mtree_index completo y las
+    // consultas leen las entradas en el sitio (sin pread, copia ni reserva de
+    // memoria por nodo visitado). Los 'hotLevels' niveles superiores se piden
+    // al kernel con MADV_WILLNEED; el resto del archivo es MADV_RANDOM.
+    // Con el índice mapeado el buffer pool no se usa.
+    void restoreMapped(const std::string& basePath, int hotLevels = 2) {
+        restore(basePath);
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size < (off_t)slotOffset(nodeCount)) {
+            closeIndex();
+            throw std::runtime_error("[MTree_Disk] Archivo truncado: " + indexPath);
+        }
 
-        auto t1 = clock::now();
-        queryTime += std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+        void* p = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            closeIndex();
+            throw std::runtime_error("[MTree_Disk] mmap falló: " + indexPath);
+        }
+        mapBase = static_cast<const char*>(p);
+        mapLen  = (size_t)st.st_size;
+
+        // los nodos se visitan de forma dispersa: sin read-ahead
+        ::madvise(p, mapLen, MADV_RANDOM);
+
+        const int64_t sysPage = ::sysconf(_SC_PAGESIZE);
+        forEachUpperNode(hotLevels, [&](int64_t off) {
+            int64_t start = off - off % sysPage;
+            ::madvise(const_cast<char*>(mapBase) + start,
+                      (size_t)(off - start) + nodeBytes(), MADV_WILLNEED);
+            return true;
+        });
     }
 
-    // MkNN (best-first, ball lower-bound, Lemma 4.2) =========
-    void knnSearch(int qId, int k, std::vector<std::pair<double,int>>& out) const 
-    {
-        using clock = std::chrono::high_resolution_clock;
-        auto t0 = clock::now();
+    bool isMapped() const { return mapBase != nullptr; }
 
-        out.clear();
-        if (!fpIndex)
-            throw std::runtime_error("[MTree_Disk] knnSearch: fpIndex==nullptr (¿faltó restore?)");
-        if (rootOffset < 0 || k <= 0) return;
-
-        // min-heap (of candidates)
-        struct NodeCand {
-            double lb;              // lower bound a la región (bola)
-            int64_t offset;         // offset del nodo hijo
-            int    parentCenterId;  // id del routing object padre
-            double distParentQ;
-        };
-        struct CmpCand {
-            bool operator()(const NodeCand& a, const NodeCand& b) const 
-            {
-                return a.lb > b.lb; // min-heap
+    // Recorre todos los nodos de un .mtree_index. Acepta el formato paginado
+    // y el formato secuencial antiguo (rootOffset + nodos de tamaño variable).
+    static bool loadAllNodes(const std::string& indexPath,
+                             int64_t& rootOut,
+                             std::vector<RawNode>& nodes)
+    {
+        nodes.clear();
+        rootOut = -1;
+
+        int f = ::open(indexPath.c_str(), O_RDONLY);
+        if (f < 0) return false;
+
+        FileHeader h;
+        if (readHeader(f, h)) {
+            size_t bytes = (size_t)h.pagesPerNode * h.pageSize;
+            std::vector<char> buf(bytes);
+            nodes.reserve((size_t)h.nodeCount);
+            for (int64_t i = 0; i < h.nodeCount; ++i) {
+                int64_t off = (int64_t)(1 + i * h.pagesPerNode) * h.pageSize;
+                if (::pread(f, buf.data(), bytes, off) != (ssize_t)bytes) {
+                    ::close(f);
+                    nodes.clear();
+                    return false;
+                }
+                RawNode rn;
+                rn.offset = off;
+                decodeRawNode(buf.data(), h.version, (int)h.pageSize, rn);
+                nodes.push_back(std::move(rn));
             }
-        };
+            ::close(f);
+            rootOut = h.rootOffset;
+            return true;
+        }
 
-        std::priority_queue<NodeCand, std::vector<NodeCand>, CmpCand> pq;
+        // formato antiguo: lectura secuencial campo a campo
+        FILE* fp = ::fdopen(f, "rb");
+        if (!fp) { ::close(f); return false; }
+        if (std::fread(&rootOut, sizeof(int64_t), 1, fp) != 1) {
+            std::fclose(fp);
+            return false;
+        }
+        while (true) {
+            int64_t pos = std::ftell(fp);
+            bool isLeaf;
+            int32_t count;
+            if (std::fread(&isLeaf, sizeof(bool), 1, fp) != 1) break;
+            if (std::fread(&count, sizeof(int32_t), 1, fp) != 1) break;
+
+            RawNode rn;
+            rn.isLeaf = isLeaf;
+            rn.offset = pos;
+            rn.entries.resize(count);
+            for (int i = 0; i < count; ++i) {
+                Entry& e = rn.entries[i];
+                if (std::fread(&e.objId,      sizeof(int32_t), 1, fp) != 1 ||
+                    std::fread(&e.radius,     sizeof(double),  1, fp) != 1 ||
+                    std::fread(&e.parentDist, sizeof(double),  1, fp) != 1 ||
+                    std::fread(&e.childOffset,sizeof(int64_t), 1, fp) != 1) {
+                    std::fclose(fp);
+                    nodes.clear();
+                    return false;
+                }
+            }
+            nodes.push_back(std::move(rn));
+        }
+        std::fclose(fp);
+        return true;
+    }
 
-        // max-heap (based on distance)
-        using Res = std::pair<double,int>;
-        std::priority_queue<Res> best;
+    // Inserción dinámica (M-tree, Ciaccia et al.). Requiere restore(base, true).
+    //  • Desciende por la entrada cuya bola contiene al objeto (la más cercana)
+    //    o, si ninguna lo contiene, por la que menos debe crecer su radio.
+    //  • Si la hoja desborda, se divide: promoción según 'promotion' y reparto
+    //    por hiperplano generalizado; la división puede propagarse hasta la raíz.
+    //  • Solo se reescriben las páginas de los nodos modificados; los nodos
+    //    nuevos se añaden al final del archivo.
+    void insert(int objId) {
+        if (fd < 0 || !isWritable || mapBase)
+            throw std::runtime_error("[MTree_Disk] insert: índice no abierto para escritura (restore(base, true))");
+        if (!db || objId < 0 || objId >= db->size())
+            throw std::runtime_error("[MTree_Disk] insert: objId fuera de la base de datos");
+        n = std::max(n, objId + 1);
+
+        const int64_t nodesBefore = nodeCount;
+        const int64_t rootBefore  = rootOffset;
+
+        if (rootOffset < 0) {
+            RawNode leaf;
+            leaf.isLeaf = true;
+            leaf.offset = allocNode();
+            leaf.entries.push_back(Entry{(int32_t)objId, 0.0, 0.0, -1});
+            writeNode(leaf);
+            rootOffset = leaf.offset;
+            writeHeader();
+            return;
+        }
 
-        NodeDisk root;
-        readNode(rootOffset, root); // page read
+        // 1) descenso: camino de nodos internos y entrada elegida en cada uno
+        std::vector<PathStep> path;
+        RawNode node;
+        loadNode(rootOffset, node);
+        int    parentObj = -1;   // routing object del nodo actual (-1 en la raíz)
+        double dParent   = 0.0;  // δ(objId, parentObj)
+
+        while (!node.isLeaf) {
+            int best = -1;
+            bool inside = false;
+            double bestD = std::numeric_limits<double>::infinity();
+            double bestGrow = std::numeric_limits<double>::infinity();
+            for (size_t i = 0; i < node.entries.size(); ++i) {
+                const Entry& e = node.entries[i];
+                double d = dist(objId, e.objId);
+                if (d <= e.radius) {
+                    if (!inside || d < bestD) { inside = true; best = (int)i; bestD = d; }
+                } else if (!inside && d - e.radius < bestGrow) {
+                    bestGrow = d - e.radius;
+                    best = (int)i;
+                    bestD = d;
+                }
+            }
 
-        for (const auto& e : root.entries) 
-        {
-            double dQR = dist(qId, e.objId);          
-            double lb   = std::max(0.0, dQR - e.radius);
+            PathStep step;
+            step.entryIdx  = best;
+            step.parentObj = parentObj;
+            step.dirty     = false;
+            Entry& chosen = node.entries[best];
+            if (bestD > chosen.radius) {
+                chosen.radius = bestD;   // la bola debe cubrir al nuevo objeto
+                step.dirty = true;
+            }
+            parentObj = chosen.objId;
+            dParent   = bestD;
+            int64_t child = chosen.childOffset;
+            step.node = std::move(node);
+            path.push_back(std::move(step));
 
-            if (root.isLeaf) 
-                insertBest(best, k, dQR, e.objId);
-            else 
-                pq.push(NodeCand{lb, e.childOffset, e.objId, dQR});
-            
+            loadNode(child, node);
         }
 
-        // best-first search
-        while (!pq.empty()) {
-            double worst = best.empty()
-                         ? std::numeric_limits<double>::infinity()
-                         : best.top().first;
+        // 2) hoja: añadir la entrada y dividir hacia arriba mientras desborde
+        node.entries.push_back(Entry{(int32_t)objId, 0.0, parentObj < 0 ? 0.0 : dParent, -1});
+
+        while ((int)node.entries.size() > (node.isLeaf ? leafCapacity : nodeCapacity)) {
+            RawNode left, right;
+            int o1, o2;
+            double r1, r2;
+            splitNode(node, left, right, o1, o2, r1, r2);
+
+            left.offset  = node.offset;   // conserva su slot
+            right.offset = allocNode();
+            writeNode(left);
+            writeNode(right);
+
+            if (path.empty()) {
+                // se dividió la raíz: nueva raíz con los dos promovidos
+                RawNode root;
+                root.isLeaf = false;
+                root.offset = allocNode();
+                root.entries.push_back(Entry{(int32_t)o1, r1, 0.0, left.offset});
+                root.entries.push_back(Entry{(int32_t)o2, r2, 0.0, right.offset});
+                writeNode(root);
+                rootOffset = root.offset;
+                node.entries.clear();
+                break;
+            }
 
-            NodeCand cand = pq.top();
-            if (cand.lb > worst) break; // ninguna región más puede mejorar
-            pq.pop();
+            PathStep& up = path.back();
+            double dp1 = up.parentObj < 0 ? 0.0 : dist(o1, up.parentObj);
+            double dp2 = up.parentObj < 0 ? 0.0 : dist(o2, up.parentObj);
+            up.node.entries[up.entryIdx] = Entry{(int32_t)o1, r1, dp1, left.offset};
+            up.node.entries.push_back(Entry{(int32_t)o2, r2, dp2, right.offset});
+            node = std::move(up.node);
+            path.pop_back();
+        }
+        if (!node.entries.empty()) writeNode(node);
 
-            NodeDisk node;
-            readNode(cand.offset, node); // pageRead 
+        // ancestros con radio ampliado que la división no reescribió
+        for (const PathStep& step : path)
+            if (step.dirty) writeNode(step.node);
 
-            if (node.isLeaf) {
-                for (const auto& e : node.entries) 
-                {
-                    double d = dist(qId, e.objId);
-                    insertBest(best, k, d, e.objId);
-                }
-            } else {
-                for (const auto& e : node.entries) 
-                {
-                    double dQR = dist(qId, e.objId);  // δ(Q,R)
-                    double lb   = std::max(0.0, dQR - e.radius);  // lower bound
+        if (nodeCount != nodesBefore || rootOffset != rootBefore)
+            writeHeader();
+    }
 
-                    double worstNow = best.empty()
-                                      ? std::numeric_limits<double>::infinity()
-                                      : best.top().first;
-                    if (lb > worstNow) continue; // (Lemma 4.2)
+    // MRQ: Range (Lemma 4.2)
+    void rangeSearch(int qId, double R, std::vector<int>& out) const 
+    {
+        using clock = std::chrono::high_resolution_clock;
+        auto t0 = clock::now();
 
-                    pq.push(NodeCand{lb, e.childOffset, e.objId, dQR});
-                }
-            }
-        }
+        out.clear();
+        if (fd < 0)
+            throw std::runtime_error("[MTree_Disk] rangeSearch: índice cerrado (¿faltó restore?)");
+        if (rootOffset < 0) return; // índice vacío
 
-        // save results in a vector
-        std::vector<Res> tmp;
-        while (!best.empty()) {
-            tmp.push_back(best.top());
-            best.pop();
-        }
-        std::reverse(tmp.begin(), tmp.end());
-        out = std::move(tmp);
+        // DFS + Lemma 4.2 + parent filtering
+        dfs_range(rootOffset, -1, 0.0, qId, R, out);
 
         auto t1 = clock::now();
         queryTime += std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
     }
 
+    // MkNN (best-first, ball lower-bound, Lemma 4.2) =========
+    // Los k primeros objetos del recorrido incremental (NearestIterator)
+    void knnSearch(int qId, int k, std::vector<std::pair<double,int>>& out) const;
+
+    // Recorrido incremental por distancia (distance browsing, Hjaltason & Samet):
+    // next() devuelve los objetos de uno en uno en orden creciente de δ(q, o),
+    // conservando la cola de nodos y objetos entre llamadas, así que se puede
+    // parar en cualquier momento sin fijar k de antemano.
+    //  • Una única cola de prioridad con tres tipos de elemento: nodo (cota
+    //    δ(q,R) - r), objeto (distancia exacta) y entrada pendiente (cota por
+    //    parentDist, sin calcular aún δ(q, ·)).
+    //  • Las entradas pendientes solo calculan su distancia al salir de la
+    //    cola: las que quedan por detrás del último objeto devuelto no cuestan nada.
+    // compDist / pageReads / queryTime se acumulan en el árbol. El iterador no
+    // debe sobrevivir al árbol ni cruzarse con build / restore / insert.
+    class NearestIterator;
+    NearestIterator nearest(int qId) const;
+
 private:
     const ObjectDB* db;
     int n;
     int nodeCapacity;  // m (máx entradas por nodo)
     int leafCapacity;  // máx entradas por hoja
+    int pageSize;      // bytes por página
+    int pagesPerNode;  // páginas alineadas por nodo
 
     std::string indexPath;
-    mutable FILE* fpIndex;
+    int fd;
+    BufferPool* pool = nullptr;
+    const char* mapBase = nullptr; // restoreMapped: archivo completo en memoria
+    size_t mapLen = 0;
     int64_t rootOffset;
+    int64_t nodeCount = 0;
+
+    // buffer de un nodo, reutilizado en cada pread/pwrite
+    mutable std::vector<char> nodeBuf;
+
+    bool isWritable = false;
+    int slimRounds = 0;
+    long long slimMoves = 0;
+    Promotion promotion = Promotion::MM_RAD;
+    int promoSamples = 10;
+    std::mt19937 rng{12345};
+
+    // nodo interno recorrido por insert y entrada por la que se descendió
+    struct PathStep {
+        RawNode node;
+        int  entryIdx;
+        int  parentObj;   // routing object que apunta a este nodo (-1 en la raíz)
+        bool dirty;       // radio de la entrada ampliado, falta escribir
+    };
 
     // ---- Nodo en RAM (para construcción tipo bulk-loading M-tree) ----
     struct NodeRAM {
@@ -249,25 +527,319 @@ private:
     };
 
     // ---- Nodo en disco para consultas ----
-    struct EntryDisk 
+    // entries apunta a 'storage' (pread / pool) o directamente al mapeo (mmap)
+    struct NodeDisk 
+    {
+        bool isLeaf = false;
+        int32_t count = 0;
+        const EntryDisk* entries = nullptr;
+        std::vector<EntryDisk> storage;
+
+        const EntryDisk* begin() const { return entries; }
+        const EntryDisk* end()   const { return entries + count; }
+    };
+
+
+    double dist(int a, int b) const {
+        compDist++;
+        return db->distance(a, b);
+    }
+
+    static int pagesFor(int capacity, int pageBytes) {
+        int need = NODE_HEADER_BYTES + capacity * ENTRY_BYTES;
+        return (need + pageBytes - 1) / pageBytes;
+    }
+
+    size_t nodeBytes() const { return (size_t)pagesPerNode * pageSize; }
+
+    void closeIndex() {
+        if (mapBase) {
+            ::munmap(const_cast<char*>(mapBase), mapLen);
+            mapBase = nullptr;
+            mapLen  = 0;
+        }
+        if (fd < 0) return;
+        if (pool) pool->invalidate(fd);
+        ::close(fd);
+        fd = -1;
+    }
+
+    // Recorre por niveles los nodos de los 'levels' niveles superiores y llama
+    // fn(offset) en cada uno; se detiene cuando fn devuelve false. No cuenta PA.
+    template <class Fn>
+    int forEachUpperNode(int levels, Fn fn) const {
+        if (fd < 0 || rootOffset < 0 || levels <= 0) return 0;
+
+        long long savedReads = pageReads;
+        int visited = 0;
+        std::vector<int64_t> level{rootOffset}, next;
+        NodeDisk node;
+        for (int l = 0; l < levels && !level.empty(); ++l) {
+            next.clear();
+            for (int64_t off : level) {
+                if (!fn(off)) {
+                    pageReads = savedReads;
+                    return visited;
+                }
+                visited++;
+                readNode(off, node);
+                if (node.isLeaf) continue;
+                for (const auto& e : node) next.push_back(childOffsetOf(e));
+            }
+            level.swap(next);
+        }
+        pageReads = savedReads;
+        return visited;
+    }
+
+    int64_t allocNode() { return slotOffset(nodeCount++); }
+
+    // offset en bytes del nodo número 'slot' (la página 0 es el header)
+    int64_t slotOffset(int64_t slot) const {
+        return (1 + slot * pagesPerNode) * (int64_t)pageSize;
+    }
+
+    // ---- Codificación de entradas ----
+    static float roundUp(double x) {
+        float f = (float)x;
+        if ((double)f < x) f = std::nextafter(f, std::numeric_limits<float>::infinity());
+        return f;
+    }
+
+    // error máximo de un parentDist redondeado al float más cercano (medio ulp;
+    // se usa el ulp completo)
+    static double parentSlack(float pd) {
+        return (double)std::nextafter(pd, std::numeric_limits<float>::infinity()) - (double)pd;
+    }
+
+    int64_t childOffsetOf(const EntryDisk& e) const {
+        return e.childPage ? (int64_t)e.childPage * pageSize : -1;
+    }
+
+    static EntryDisk compress(const Entry& e, int pageBytes) {
+        if (e.childOffset >= 0 && e.childOffset / pageBytes > (int64_t)UINT32_MAX)
+            throw std::runtime_error("[MTree_Disk] nº de página fuera de rango (32 bits)");
+        EntryDisk d;
+        d.objId      = e.objId;
+        d.radius     = roundUp(e.radius);
+        d.parentDist = (float)e.parentDist;
+        d.childPage  = e.childOffset < 0 ? 0u : (uint32_t)(e.childOffset / pageBytes);
+        return d;
+    }
+
+    static Entry expand(const EntryDisk& d, int pageBytes) {
+        return Entry{d.objId, (double)d.radius, (double)d.parentDist,
+                     d.childPage ? (int64_t)d.childPage * pageBytes : (int64_t)-1};
+    }
+
+    // formato v1: entradas de 28 B (solo lectura en loadAllNodes)
+#pragma pack(push, 1)
+    struct EntryDiskV1
     {
         int32_t objId;
         double  radius;
         double  parentDist;
-        int64_t childOffset; // -1 en hojas
+        int64_t childOffset;
     };
+#pragma pack(pop)
+
+    static void decodeNode(const char* buf, bool& isLeaf, std::vector<EntryDisk>& entries) {
+        NodeHeader nh;
+        std::memcpy(&nh, buf, sizeof(NodeHeader));
+        isLeaf = nh.isLeaf != 0;
+        entries.resize(nh.count);
+        if (nh.count > 0)
+            std::memcpy(entries.data(), buf + sizeof(NodeHeader),
+                        (size_t)nh.count * sizeof(EntryDisk));
+    }
 
-    struct NodeDisk 
+    static void decodeRawNode(const char* buf, uint32_t version, int pageBytes, RawNode& rn) {
+        NodeHeader nh;
+        std::memcpy(&nh, buf, sizeof(NodeHeader));
+        rn.isLeaf = nh.isLeaf != 0;
+        rn.entries.resize(nh.count);
+        const char* p = buf + sizeof(NodeHeader);
+        for (int i = 0; i < nh.count; ++i) {
+            if (version == 1) {
+                EntryDiskV1 v;
+                std::memcpy(&v, p + (size_t)i * sizeof(EntryDiskV1), sizeof(EntryDiskV1));
+                rn.entries[i] = Entry{v.objId, v.radius, v.parentDist, v.childOffset};
+            } else {
+                EntryDisk d;
+                std::memcpy(&d, p + (size_t)i * sizeof(EntryDisk), sizeof(EntryDisk));
+                rn.entries[i] = expand(d, pageBytes);
+            }
+        }
+    }
+
+    // acepta v1 y v2 (loadAllNodes); restore exige FORMAT_VERSION
+    static bool readHeader(int f, FileHeader& h) {
+        if (::pread(f, &h, sizeof(FileHeader), 0) != (ssize_t)sizeof(FileHeader))
+            return false;
+        return std::memcmp(h.magic, "MTREEPG", 8) == 0 &&
+               h.version >= 1 && h.version <= FORMAT_VERSION &&
+               h.pageSize > 0 && h.pagesPerNode > 0;
+    }
+
+    void writeHeader() {
+        std::vector<char> page(pageSize, 0);
+        FileHeader h;
+        std::memset(&h, 0, sizeof(FileHeader));
+        std::memcpy(h.magic, "MTREEPG", 8);
+        h.version      = FORMAT_VERSION;
+        h.pageSize     = (uint32_t)pageSize;
+        h.pagesPerNode = (uint32_t)pagesPerNode;
+        h.nodeCapacity = (uint32_t)std::max(nodeCapacity, leafCapacity);
+        h.rootOffset   = rootOffset;
+        h.nodeCount    = nodeCount;
+        std::memcpy(page.data(), &h, sizeof(FileHeader));
+        writePages(0, page.data(), page.size());
+        pageWrites++;
+    }
+
+    // pwrite directo, o write-through si hay un pool con páginas de este archivo
+    void writePages(int64_t offset, const char* buf, size_t len) {
+        if (pool) {
+            pool->write(fd, offset, len, buf);
+            return;
+        }
+        if (::pwrite(fd, buf, len, offset) != (ssize_t)len)
+            throw std::runtime_error("[MTree_Disk] pwrite falló");
+    }
+
+    // serializa un nodo (NodeHeader + entradas compactas) en nodeBuf
+    void encodeNode(bool isLeaf, const Entry* entries, size_t count) {
+        std::fill(nodeBuf.begin(), nodeBuf.end(), 0);
+        NodeHeader nh;
+        std::memset(&nh, 0, sizeof(NodeHeader));
+        nh.isLeaf = isLeaf ? 1 : 0;
+        nh.count  = (int32_t)count;
+        std::memcpy(nodeBuf.data(), &nh, sizeof(NodeHeader));
+        EntryDisk* ed = reinterpret_cast<EntryDisk*>(nodeBuf.data() + sizeof(NodeHeader));
+        for (size_t i = 0; i < count; ++i)
+            ed[i] = compress(entries[i], pageSize);
+    }
+
+    void writeNode(const RawNode& node) {
+        encodeNode(node.isLeaf, node.entries.data(), node.entries.size());
+        writePages(node.offset, nodeBuf.data(), nodeBuf.size());
+        pageWrites += pagesPerNode;
+    }
+
+    void loadNode(int64_t offset, RawNode& node) const {
+        NodeDisk nd;
+        readNode(offset, nd);
+        node.isLeaf = nd.isLeaf;
+        node.offset = offset;
+        node.entries.clear();
+        node.entries.reserve(nd.count);
+        for (const EntryDisk& e : nd) node.entries.push_back(expand(e, pageSize));
+    }
+
+    // ---- División de nodos (insert) ----
+
+    // Reparto por hiperplano generalizado: cada entrada va con el promovido
+    // más cercano (empates al grupo más pequeño). d1/d2 = distancias de cada
+    // entrada a los promovidos i1/i2. Devuelve los radios de cobertura.
+    static void hyperplanePartition(const RawNode& node,
+                                    const std::vector<double>& d1,
+                                    const std::vector<double>& d2,
+                                    int i1, int i2,
+                                    std::vector<char>& side,
+                                    double& r1, double& r2)
     {
-        bool isLeaf;
-        int32_t count;
-        std::vector<EntryDisk> entries;
-    };
+        size_t m = node.entries.size();
+        side.assign(m, 0);
+        size_t n1 = 0, n2 = 0;
+        r1 = r2 = 0.0;
+        for (size_t j = 0; j < m; ++j) {
+            bool second;
+            if ((int)j == i1)      second = false;
+            else if ((int)j == i2) second = true;
+            else if (d1[j] != d2[j]) second = d2[j] < d1[j];
+            else                   second = n2 < n1;
+
+            double cover = node.isLeaf ? 0.0 : node.entries[j].radius;
+            if (second) { side[j] = 1; n2++; r2 = std::max(r2, d2[j] + cover); }
+            else        {              n1++; r1 = std::max(r1, d1[j] + cover); }
+        }
+    }
+
+    // Elige los dos routing objects según la política de promoción
+    void promote(const RawNode& node, int& i1, int& i2,
+                 std::vector<double>& d1, std::vector<double>& d2)
+    {
+        const int m = (int)node.entries.size();
+        std::vector<std::vector<double>> rows(m);
+        auto row = [&](int c) -> const std::vector<double>& {
+            if (rows[c].empty()) {
+                rows[c].assign(m, 0.0);
+                for (int j = 0; j < m; ++j)
+                    if (j != c) rows[c][j] = dist(node.entries[c].objId, node.entries[j].objId);
+            }
+            return rows[c];
+        };
 
+        std::vector<char> side;
+        double bestCost = std::numeric_limits<double>::infinity();
+        auto consider = [&](int a, int b) {
+            double r1, r2;
+            hyperplanePartition(node, row(a), row(b), a, b, side, r1, r2);
+            double cost = std::max(r1, r2);
+            if (cost < bestCost) { bestCost = cost; i1 = a; i2 = b; }
+        };
 
-    double dist(int a, int b) const {
-        compDist++;
-        return db->distance(a, b);
+        i1 = 0;
+        i2 = 1;
+        if (promotion == Promotion::MM_RAD) {
+            // matriz completa (m(m-1)/2 distancias, simétrica)
+            for (int a = 0; a < m; ++a) {
+                rows[a].assign(m, 0.0);
+                for (int b = 0; b < a; ++b)
+                    rows[a][b] = rows[b][a];
+                for (int b = a + 1; b < m; ++b)
+                    rows[a][b] = dist(node.entries[a].objId, node.entries[b].objId);
+            }
+            for (int a = 0; a < m; ++a)
+                for (int b = a + 1; b < m; ++b)
+                    consider(a, b);
+        } else {
+            std::uniform_int_distribution<int> pick(0, m - 1);
+            int pairs = promotion == Promotion::RANDOM ? 1 : promoSamples;
+            for (int s = 0; s < pairs; ++s) {
+                int a = pick(rng), b = pick(rng);
+                while (b == a) b = pick(rng);
+                if (promotion == Promotion::RANDOM) { i1 = a; i2 = b; break; }
+                consider(a, b);
+            }
+        }
+
+        d1 = row(i1);
+        d2 = row(i2);
+    }
+
+    // Divide un nodo desbordado en left / right (sin offsets) y devuelve los
+    // promovidos con sus radios; parentDist pasa a ser la distancia al promovido
+    void splitNode(const RawNode& node, RawNode& left, RawNode& right,
+                   int& o1, int& o2, double& r1, double& r2)
+    {
+        int i1, i2;
+        std::vector<double> d1, d2;
+        promote(node, i1, i2, d1, d2);
+
+        std::vector<char> side;
+        hyperplanePartition(node, d1, d2, i1, i2, side, r1, r2);
+
+        left.isLeaf = right.isLeaf = node.isLeaf;
+        left.entries.clear();
+        right.entries.clear();
+        for (size_t j = 0; j < node.entries.size(); ++j) {
+            Entry e = node.entries[j];
+            if (side[j]) { e.parentDist = d2[j]; right.entries.push_back(e); }
+            else         { e.parentDist = d1[j]; left.entries.push_back(e);  }
+        }
+        o1 = node.entries[i1].objId;
+        o2 = node.entries[i2].objId;
     }
 
 
@@ -419,6 +991,61 @@ NodeRAM* build_recursive(const std::vector<int>& objs, int parentCenterId) {
 }
 
 
+    // Slim-down (Traina et al.) sobre el árbol en RAM, antes de escribirlo.
+    // Entre las hojas hijas de un mismo nodo: la entrada más lejana de cada
+    // hoja (la que fija su radio) se mueve a una hoja hermana que ya la cubre
+    // y tiene espacio, y el radio de la hoja origen se recalcula (exacto, con
+    // las parentDist). Los radios superiores no cambian: los objetos no salen
+    // del subárbol del nodo.
+    void slimDown(NodeRAM* node) {
+        if (!node || node->isLeaf) return;
+        for (auto& e : node->entries) slimDown(e.child);
+
+        std::vector<size_t> leaves;
+        for (size_t i = 0; i < node->entries.size(); ++i)
+            if (node->entries[i].child->isLeaf) leaves.push_back(i);
+        if (leaves.size() < 2) return;
+
+        for (int round = 0; round < slimRounds; ++round) {
+            bool moved = false;
+            for (size_t a : leaves) {
+                auto& src = node->entries[a].child->entries;
+                if (src.size() <= 1) continue;
+
+                size_t far = 0;
+                for (size_t j = 1; j < src.size(); ++j)
+                    if (src[j].parentDist > src[far].parentDist) far = j;
+                if (src[far].parentDist <= 0.0) continue;
+
+                int obj = src[far].objId;
+                int bestLeaf = -1;
+                double bestD = std::numeric_limits<double>::infinity();
+                for (size_t b : leaves) {
+                    if (b == a) continue;
+                    const auto& eb = node->entries[b];
+                    if ((int)eb.child->entries.size() >= leafCapacity) continue;
+                    double d = dist(obj, eb.objId);
+                    if (d <= eb.radius && d < bestD) { bestD = d; bestLeaf = (int)b; }
+                }
+                if (bestLeaf < 0) continue;
+
+                typename NodeRAM::EntryRAM e = src[far];
+                e.parentDist = bestD;
+                node->entries[bestLeaf].child->entries.push_back(e);
+                src[far] = src.back();
+                src.pop_back();
+
+                double rad = 0.0;
+                for (const auto& r : src) rad = std::max(rad, r.parentDist);
+                node->entries[a].radius = rad;
+
+                moved = true;
+                slimMoves++;
+            }
+            if (!moved) break;
+        }
+    }
+
     int64_t writeNodeRec(NodeRAM* node) {
         if (!node) return -1;
 
@@ -433,32 +1060,22 @@ NodeRAM* build_recursive(const std::vector<int>& objs, int parentCenterId) {
             }
         }
 
-        // 2) Escribir este nodo y devolver su offset
-        std::fseek(fpIndex, 0, SEEK_END);
-        int64_t offset = std::ftell(fpIndex);
-
-        bool isLeaf = node->isLeaf;
-        int32_t count = (int32_t)node->entries.size();
-
-        std::fwrite(&isLeaf, sizeof(bool), 1, fpIndex);
-        std::fwrite(&count, sizeof(int32_t), 1, fpIndex);
-
+        // 2) Escribir este nodo en el siguiente slot y devolver su offset
+        RawNode out;
+        out.isLeaf = node->isLeaf;
+        out.offset = allocNode();
+        out.entries.resize(node->entries.size());
         for (size_t i = 0; i < node->entries.size(); ++i) {
             const auto& er = node->entries[i];
-            EntryDisk ed;
+            Entry& ed = out.entries[i];
             ed.objId      = (int32_t)er.objId;
             ed.radius     = er.radius;
             ed.parentDist = er.parentDist;
             ed.childOffset= node->isLeaf ? -1 : childOffsets[i];
-            std::fwrite(&ed.objId,      sizeof(int32_t), 1, fpIndex);
-            std::fwrite(&ed.radius,     sizeof(double),  1, fpIndex);
-            std::fwrite(&ed.parentDist, sizeof(double),  1, fpIndex);
-            std::fwrite(&ed.childOffset,sizeof(int64_t), 1, fpIndex);
         }
+        writeNode(out);
 
-        pageWrites++; // 1 nodo = 1 página lógica
-
-        return offset;
+        return out.offset;
     }
 
     void freeTree(NodeRAM* node) {
@@ -471,35 +1088,33 @@ NodeRAM* build_recursive(const std::vector<int>& objs, int parentCenterId) {
         delete node;
     }
 
-    // read from disk
+    // read from disk: un único pread por nodo, o lectura en el sitio si está mapeado
     void readNode(int64_t offset, NodeDisk& node) const {
-        if (!fpIndex)
-            throw std::runtime_error("[MTree_Disk] readNode: fpIndex==nullptr");
-
-        std::fseek(fpIndex, offset, SEEK_SET);
-        bool isLeaf;
-        int32_t count;
-        if (std::fread(&isLeaf, sizeof(bool), 1, fpIndex) != 1)
-            throw std::runtime_error("[MTree_Disk] readNode: fread isLeaf falló");
-        if (std::fread(&count, sizeof(int32_t), 1, fpIndex) != 1)
-            throw std::runtime_error("[MTree_Disk] readNode: fread count falló");
-
-        node.isLeaf = isLeaf;
-        node.count  = count;
-        node.entries.resize(count);
-
-        for (int i = 0; i < count; ++i) {
-            EntryDisk ed;
-            if (std::fread(&ed.objId,      sizeof(int32_t), 1, fpIndex) != 1 ||
-                std::fread(&ed.radius,     sizeof(double),  1, fpIndex) != 1 ||
-                std::fread(&ed.parentDist, sizeof(double),  1, fpIndex) != 1 ||
-                std::fread(&ed.childOffset,sizeof(int64_t), 1, fpIndex) != 1) {
-                throw std::runtime_error("[MTree_Disk] readNode: fread entry falló");
-            }
-            node.entries[i] = ed;
+        if (fd < 0)
+            throw std::runtime_error("[MTree_Disk] readNode: índice cerrado");
+
+        if (mapBase) {
+            if (offset < 0 || (size_t)offset + nodeBytes() > mapLen)
+                throw std::runtime_error("[MTree_Disk] readNode: offset fuera del mapeo");
+            NodeHeader nh;
+            std::memcpy(&nh, mapBase + offset, sizeof(NodeHeader));
+            node.isLeaf  = nh.isLeaf != 0;
+            node.count   = nh.count;
+            node.entries = reinterpret_cast<const EntryDisk*>(mapBase + offset + sizeof(NodeHeader));
+            pageReads += pagesPerNode;
+            return;
         }
 
-        pageReads++; // Page Access
+        if (pool)
+            pool->read(fd, offset, nodeBuf.size(), nodeBuf.data());
+        else if (::pread(fd, nodeBuf.data(), nodeBuf.size(), offset) != (ssize_t)nodeBuf.size())
+            throw std::runtime_error("[MTree_Disk] readNode: pread falló");
+
+        decodeNode(nodeBuf.data(), node.isLeaf, node.storage);
+        node.count   = (int32_t)node.storage.size();
+        node.entries = node.storage.data();
+
+        pageReads += pagesPerNode; // Page Access (físicas)
     }
 
     // dfs for MRQ
@@ -513,12 +1128,12 @@ NodeRAM* build_recursive(const std::vector<int>& objs, int parentCenterId) {
         NodeDisk node;
         readNode(offset, node);
 
-        for (const auto& e : node.entries) {
+        for (const auto& e : node) {
             // --- Parent filtering (si hay padre) ---
             if (parentCenterId >= 0) {
                 double dPQ = distParentQ;  
                 double dPR = e.parentDist; 
-                if (std::fabs(dPQ - dPR) > R + e.radius) {
+                if (std::fabs(dPQ - dPR) > R + e.radius + parentSlack(e.parentDist)) {
                     // la bola (R,r) no intersecta B(Q,R)
                     continue;
                 }
@@ -535,22 +1150,112 @@ NodeRAM* build_recursive(const std::vector<int>& objs, int parentCenterId) {
                     out.push_back(e.objId);
             } else {
                 // Bola interna: descender al hijo
-                dfs_range(e.childOffset, e.objId, dQR, qId, R, out);
+                dfs_range(childOffsetOf(e), e.objId, dQR, qId, R, out);
             }
         }
     }
+};
 
-    // maintain k-best in a heap
-    static void insertBest(std::priority_queue<std::pair<double,int>>& best,
-                           int k, double d, int id)
+class MTree_Disk::NearestIterator {
+public:
+    NearestIterator(const MTree_Disk& tree_, int qId_)
+        : tree(&tree_), qId(qId_)
     {
-        if ((int)best.size() < k) {
-            best.emplace(d, id);
-        } else if (d < best.top().first) {
-            best.pop();
-            best.emplace(d, id);
+        if (tree->fd < 0)
+            throw std::runtime_error("[MTree_Disk] NearestIterator: índice cerrado (¿faltó restore?)");
+        if (tree->rootOffset >= 0)
+            pq.push(Item{0.0, NODE, -1, 0.0f, tree->rootOffset, 0.0});
+    }
+
+    // Siguiente vecino (distancia, id); false cuando no quedan objetos
+    bool next(std::pair<double,int>& out) {
+        using clock = std::chrono::high_resolution_clock;
+        auto t0 = clock::now();
+
+        bool found = false;
+        while (!pq.empty()) {
+            Item it = pq.top();
+            pq.pop();
+
+            if (it.kind == OBJECT) {
+                out = {it.key, it.objId};
+                found = true;
+                break;
+            }
+
+            if (it.kind == PENDING) {
+                double d = tree->dist(qId, it.objId);
+                if (it.child < 0)
+                    pq.push(Item{d, OBJECT, it.objId, 0.0f, -1, d});
+                else
+                    pq.push(Item{std::max(0.0, d - it.radius), NODE, it.objId, 0.0f, it.child, d});
+                continue;
+            }
+
+            // NODE: sus entradas entran como pendientes con la cota por parentDist
+            tree->readNode(it.child, node);
+            for (const auto& e : node) {
+                double lb = 0.0;
+                if (it.objId >= 0)
+                    lb = std::max(0.0, std::fabs(it.dq - e.parentDist)
+                                       - e.radius - parentSlack(e.parentDist));
+                lb = std::max(lb, it.key);  // nunca por debajo de la cota del padre
+                pq.push(Item{lb, PENDING, e.objId, e.radius,
+                             node.isLeaf ? -1 : tree->childOffsetOf(e), 0.0});
+            }
         }
+
+        auto t1 = clock::now();
+        tree->queryTime += std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+        return found;
+    }
+
+    // Cota inferior de la distancia del próximo objeto (infinito si no quedan)
+    double lowerBound() const {
+        return pq.empty() ? std::numeric_limits<double>::infinity() : pq.top().key;
     }
+
+private:
+    enum Kind : uint8_t { OBJECT, PENDING, NODE };
+
+    struct Item {
+        double  key;     // distancia exacta (OBJECT) o cota inferior
+        Kind    kind;
+        int     objId;   // objeto / routing object (-1: raíz)
+        float   radius;  // PENDING: radio de la entrada
+        int64_t child;   // offset del nodo (NODE / PENDING interna); -1 en hojas
+        double  dq;      // NODE: δ(q, routing object)
+    };
+    struct CmpItem {
+        bool operator()(const Item& a, const Item& b) const {
+            if (a.key != b.key) return a.key > b.key;   // min-heap
+            return a.kind > b.kind;                     // a igual cota, objetos primero
+        }
+    };
+
+    const MTree_Disk* tree;
+    int qId;
+    std::priority_queue<Item, std::vector<Item>, CmpItem> pq;
+    NodeDisk node;  // reutilizado en cada lectura
 };
 
+inline MTree_Disk::NearestIterator MTree_Disk::nearest(int qId) const
+{
+    return NearestIterator(*this, qId);
+}
+
+inline void MTree_Disk::knnSearch(int qId, int k, std::vector<std::pair<double,int>>& out) const
+{
+    out.clear();
+    if (fd < 0)
+        throw std::runtime_error("[MTree_Disk] knnSearch: índice cerrado (¿faltó restore?)");
+    if (rootOffset < 0 || k <= 0) return;
+
+    NearestIterator it(*this, qId);
+    std::pair<double,int> nn;
+    out.reserve(k);
+    while ((int)out.size() < k && it.next(nn))
+        out.push_back(nn);
+}
+
 #endif // MTREE_DISK_HPP
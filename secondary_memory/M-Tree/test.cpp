@@ -1,5 +1,6 @@
 #include <bits/stdc++.h>
 #include "mtree.hpp"     
+#include "../buffer_pool.hpp"
 #include "../../objectdb.hpp"
 #include "../../datasets/paths.hpp"
 
@@ -15,6 +16,21 @@ static const vector<int> K_VALUES = {5, 10, 20, 50, 100};
 // static const vector<string> DATASETS = {"LA", "Words", "Color", "Synthetic"};
 static const vector<string> DATASETS = {"LA"};
 
+// Buffer pool compartido: presupuesto en páginas de 4KB (0 = sin caché)
+static const size_t BUFFER_POOL_PAGES = 1024;
+static const BufferPool::Policy BUFFER_POOL_POLICY = BufferPool::Policy::LRU;
+// Niveles superiores del árbol fijados en el pool (raíz = 1)
+static const int PINNED_LEVELS = 1;
+// true = servir las consultas con el índice mapeado (restoreMapped) en lugar
+// de pread + buffer pool; PINNED_LEVELS pasa a ser los niveles con MADV_WILLNEED
+static const bool SERVE_MMAP = false;
+// Objetos finales del dataset que se añaden con insert() después del
+// bulk-loading (0 = todo por bulk-loading) y política de promoción al dividir
+static const int INSERT_TAIL = 0;
+static const MTree_Disk::Promotion INSERT_PROMOTION = MTree_Disk::Promotion::MM_RAD;
+// Pasadas de Slim-down tras el bulk-loading (0 = desactivado)
+static const int SLIM_DOWN_ROUNDS = 0;
+
 int main(int argc, char** argv) {
     srand(12345);
     vector<string> datasets;
@@ -70,16 +86,45 @@ int main(int argc, char** argv) {
         int pageBytes = (dataset == "Color" || dataset == "Synthetic") ?
                         40960 : 4096;
 
-        // Aridad aproximada = pageBytes / tamañoEntrada
-        // Tamaño entrada: objId(4) + radius(8) + parentDist(8) + child(8) = 28B
-        int entryBytes = 4 + 8 + 8 + 8;
-        int nodeCapacity = max(4, pageBytes / entryBytes);
+        // Aridad = (pageBytes - header de nodo 8B) / tamañoEntrada
+        // Tamaño entrada: objId(4) + radius(f32) + parentDist(f32) + página hijo(4) = 16B
+        int nodeCapacity = MTree_Disk::capacityForPage(pageBytes);
+
+        // caché caliente a lo largo de todas las consultas del dataset
+        // (declarado antes del índice: debe sobrevivirlo)
+        BufferPool pool(BUFFER_POOL_PAGES, 4096, BUFFER_POOL_POLICY);
 
-        MTree_Disk mt(db.get(), nodeCapacity);
+        // cada nodo ocupa exactamente una página de pageBytes
+        MTree_Disk mt(db.get(), nodeCapacity, pageBytes);
 
         string base = "mtree_indexes/" + dataset;
-        mt.build(base);       // escribe base.mtree_index
-        mt.restore(base);     // vuelve a abrir para queries
+        int nBulk = max(0, db->size() - INSERT_TAIL);
+        mt.setSlimDown(SLIM_DOWN_ROUNDS);
+        mt.build(base, nBulk);  // escribe base.mtree_index
+        if (SLIM_DOWN_ROUNDS > 0)
+            cerr << "[MTree] slim-down: " << mt.get_slimMoves() << " entradas movidas\n";
+
+        if (nBulk < db->size()) {
+            mt.restore(base, true);
+            mt.setPromotion(INSERT_PROMOTION);
+            long long w0 = mt.get_pageWrites();
+            for (int id = nBulk; id < db->size(); ++id)
+                mt.insert(id);
+            cerr << "[MTree] insertados " << (db->size() - nBulk)
+                 << " objetos, páginas escritas=" << (mt.get_pageWrites() - w0) << "\n";
+        }
+
+        if (SERVE_MMAP) {
+            mt.restoreMapped(base, PINNED_LEVELS);  // solo lectura, sin pool
+            cerr << "[MTree] índice mapeado en memoria (mmap)\n";
+        } else {
+            mt.restore(base);     // vuelve a abrir para queries
+
+            mt.attachBufferPool(&pool);
+            int pinnedNodes = mt.pinUpperLevels(PINNED_LEVELS);
+            cerr << "[MTree] buffer pool: " << BUFFER_POOL_PAGES << " páginas ("
+                 << pool.policyName() << "), nodos fijados=" << pinnedNodes << "\n";
+        }
 
         // MRQ
         cout << "Searching...\n";
@@ -88,6 +133,7 @@ int main(int argc, char** argv) {
 
             double R = radii[sel];
             long long totalD = 0, totalT = 0, totalPages = 0;
+            pool.reset_stats();
 
             for (int q : queries) {
                 vector<int> out;
@@ -121,6 +167,10 @@ int main(int argc, char** argv) {
               << "\"compdists\":" << avgD << ","
               << "\"time_ms\":" << avgTms << ","
               << "\"pages\":" << avgPA << ","
+              << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+              << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+              << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+              << "\"hit_rate\":" << pool.get_hitRate() << ","
               << "\"n_queries\":" << queries.size() << ","
               << "\"run_id\":1"
               << "}";
@@ -129,6 +179,7 @@ int main(int argc, char** argv) {
         // MkNN
         for (int k : K_VALUES) {
             long long totalD = 0, totalT = 0, totalPages = 0;
+            pool.reset_stats();
 
             for (int q : queries) {
                 vector<pair<double,int>> out;
@@ -162,6 +213,10 @@ int main(int argc, char** argv) {
               << "\"compdists\":" << avgD << ","
               << "\"time_ms\":" << avgTms << ","
               << "\"pages\":" << avgPA << ","
+              << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+              << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+              << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+              << "\"hit_rate\":" << pool.get_hitRate() << ","
               << "\"n_queries\":" << queries.size() << ","
               << "\"run_id\":1"
               << "}";
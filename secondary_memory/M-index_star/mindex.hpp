@@ -2,11 +2,13 @@
 #define MINDEX_IMPROVED_HPP
 
 #include "../../objectdb.hpp"
+#include "../buffer_pool.hpp"
 #include <vector>
 #include <string>
 #include <fstream>
 #include <cstdio>
 #include <cstdint>
+#include <cstring>
 #include <limits>
 #include <queue>
 #include <algorithm>
@@ -15,10 +17,11 @@
 #include <cmath>
 #include <random>
 #include <filesystem>
-#include <map>
-#include <unordered_map>
 #include <unordered_set>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 
 class MIndex_Improved {
 public:
@@ -34,32 +37,67 @@ public:
         std::vector<double> minDist; // MBB: min distance to each pivot
         std::vector<double> maxDist; // MBB: max distance to each pivot
         std::vector<int32_t> children;
-        int64_t rafOffset;
         int32_t count;
+        int32_t pivot;               // hoja: pivote más cercano (i0) de sus objetos
+        double  keyBase;             // hoja: key = d(p_i0, o) + keyBase
         ClusterNode()
             : isLeaf(false), minkey(0.0), maxkey(0.0),
-              rafOffset(-1), count(0) {}
+              count(0), pivot(-1), keyBase(0.0) {}
     };
 
 private:
-    static constexpr size_t PAGE_SIZE = 4096; // 4KB físicos para conteo de pages
+    static constexpr size_t PAGE_SIZE = 4096; // 4KB físicos por página del B+-tree
+
+    // ---- B+-tree en disco (<base>.midx_btree) ----
+    // Página 0: cabecera. Resto: nodos de PAGE_SIZE bytes.
+    //  • Hoja: PageHeader + registros {double key; double dists[P]; int32 id}
+    //    en orden de key; 'next' enlaza con la hoja siguiente.
+    //  • Interna: PageHeader + count keys (double) + count hijos (int32);
+    //    keys[i] es la primera key del subárbol hijos[i].
+    // Se construye por bulk-loading a partir de las entradas ordenadas.
+    struct BTreeHeader {
+        char    magic[8];    // "MIDXBT1"
+        int32_t P;
+        int32_t rootPage;
+        int32_t height;      // 1 = la raíz es hoja
+        int32_t firstLeaf;
+        int32_t pageCount;
+        int32_t reserved;
+        int64_t entries;
+    };
+
+    struct PageHeader {
+        uint8_t  isLeaf;
+        uint8_t  pad;
+        uint16_t count;
+        int32_t  next;       // hoja siguiente (-1 = última)
+    };
 
     const ObjectDB* db;
     int n;
     int P;                         // number of pivots
     std::vector<int32_t> pivots;   // pivot ids
     bool pivotsFixed = false;      // true si vienen de HFI/override
-    double dplus;                  // maximum distance observed
-
-    std::vector<ClusterNode> nodes;
+    double dplus;                  // cota estricta de las distancias a pivotes
 
-    std::map<double, std::vector<RAFEntry>> btreeIndex;
+    // Particionado recursivo (M-index): un cluster con más de maxClusterSize
+    // objetos se divide por el siguiente pivote más cercano, hasta maxLevel
+    int maxLevel       = 3;
+    int maxClusterSize = 256;
 
-    // RAF en disco
-    std::string rafPath;
-    mutable std::unordered_map<int32_t, std::streampos> rafOffsets;   // id -> offset
-    mutable std::unordered_set<uint64_t> rafPagesVisited;             // páginas físicas tocadas
-    mutable std::ifstream rafIn;                                      // stream de lectura
+    std::vector<ClusterNode> nodes;
+    std::vector<int32_t>     roots;  // clusters de primer nivel (uno por pivote)
+
+    std::string btreePath;
+    int    btreeFd    = -1;
+    int    rootPage   = -1;
+    int    height     = 0;
+    size_t recordSize = 0;                                            // bytes por entrada de hoja
+    size_t leafCap    = 0;                                            // entradas por hoja
+    size_t innerCap   = 0;                                            // hijos por nodo interno
+    mutable std::vector<char> pageBuf;
+    mutable std::unordered_set<int32_t> pagesVisited;                 // páginas tocadas en la consulta
+    BufferPool* pool = nullptr;                                       // caché de páginas (opcional)
 
     // Metrics
     mutable long long compDist   = 0;
@@ -72,33 +110,70 @@ private:
         return db->distance(a,b);
     }
 
-    // Leer (y marcar página) en el RAF para un objeto dado
-    void touchRAF(int32_t id) const {
-        auto it = rafOffsets.find(id);
-        if (it == rafOffsets.end()) {
-            // No debería pasar si build se hizo bien, pero evitamos crash.
-            return;
-        }
-
-        // Marcar página física (4KB) tocada
-        long long off = static_cast<long long>(it->second);
-        uint64_t pageId = static_cast<uint64_t>(
-            off / static_cast<long long>(PAGE_SIZE)
-        );
-        rafPagesVisited.insert(pageId);
-
-        if (!rafIn.is_open()) return;
+    void closeBtreeFd() {
+        if (btreeFd < 0) return;
+        if (pool) pool->invalidate(btreeFd);
+        ::close(btreeFd);
+        btreeFd = -1;
+    }
 
-        rafIn.clear();                    // limpiar flags anteriores
-        rafIn.seekg(it->second);          // posicionarse en el registro
+    // Lee una página del B+-tree (vía pool si hay) y la marca como tocada
+    const char* readPage(int32_t page) const {
+        pagesVisited.insert(page);
+        int64_t off = (int64_t)page * (int64_t)PAGE_SIZE;
+        if (pool) {
+            pool->read(btreeFd, off, PAGE_SIZE, pageBuf.data());
+        } else if (::pread(btreeFd, pageBuf.data(), PAGE_SIZE, (off_t)off) != (ssize_t)PAGE_SIZE) {
+            throw std::runtime_error("MIndex_Improved: B+-tree read failed");
+        }
+        return pageBuf.data();
+    }
 
-        int32_t dummyId;
-        rafIn.read(reinterpret_cast<char*>(&dummyId), sizeof(int32_t));
+    // Recorre en orden las entradas con key en [lo, hi]: baja hasta la
+    // primera hoja que puede contenerlas y sigue la cadena de hojas.
+    // f(id, dists) recibe las distancias a pivotes guardadas en la hoja.
+    template <class F>
+    void scanKeyRange(double lo, double hi, F&& f) const {
+        if (rootPage < 0) return;
+
+        int32_t page = rootPage;
+        for (int level = height; level > 1; --level) {
+            const char* buf = readPage(page);
+            PageHeader h;
+            std::memcpy(&h, buf, sizeof(PageHeader));
+            const char* keys = buf + sizeof(PageHeader);
+            const char* kids = keys + innerCap * sizeof(double);
+
+            // último hijo cuya primera key es < lo (las keys repetidas
+            // pueden empezar en el hijo anterior)
+            int idx = 0;
+            for (int i = 1; i < h.count; ++i) {
+                double k;
+                std::memcpy(&k, keys + i * sizeof(double), sizeof(double));
+                if (k < lo) idx = i;
+                else break;
+            }
+            std::memcpy(&page, kids + idx * sizeof(int32_t), sizeof(int32_t));
+        }
 
-        // Saltar distancias a pivotes + key
-        std::streamsize skipBytes =
-            static_cast<std::streamsize>(sizeof(double) * (P + 1));
-        rafIn.ignore(skipBytes);
+        std::vector<double> dists(P);
+        while (page >= 0) {
+            const char* buf = readPage(page);
+            PageHeader h;
+            std::memcpy(&h, buf, sizeof(PageHeader));
+            const char* rec = buf + sizeof(PageHeader);
+            for (int i = 0; i < h.count; ++i, rec += recordSize) {
+                double key;
+                std::memcpy(&key, rec, sizeof(double));
+                if (key < lo) continue;
+                if (key > hi) return;
+                int32_t id;
+                std::memcpy(dists.data(), rec + sizeof(double), P * sizeof(double));
+                std::memcpy(&id, rec + (1 + P) * sizeof(double), sizeof(int32_t));
+                f(id, dists.data());
+            }
+            page = h.next;
+        }
     }
 
 public:
@@ -112,7 +187,17 @@ public:
     }
 
     ~MIndex_Improved() {
-        if (rafIn.is_open()) rafIn.close();
+        closeBtreeFd();
+    }
+
+    MIndex_Improved(const MIndex_Improved&) = delete;
+    MIndex_Improved& operator=(const MIndex_Improved&) = delete;
+
+    // Lecturas del B+-tree a través de un buffer pool compartido (nullptr = pread).
+    // El pool debe vivir más que el índice.
+    void attachBufferPool(BufferPool* pool_) {
+        if (pool && btreeFd >= 0) pool->invalidate(btreeFd);
+        pool = pool_;
     }
 
     // API de métricas
@@ -121,7 +206,7 @@ public:
         pageReads  = 0;
         pageWrites = 0;
         queryTime  = 0;
-        rafPagesVisited.clear();
+        pagesVisited.clear();
     }
     long long get_compDist()   const { return compDist;   }
     long long get_pageReads()  const { return pageReads;  }
@@ -129,6 +214,15 @@ public:
     long long get_queryTime()  const { return queryTime;  }
 
     int get_num_pivots() const { return P; }
+    int get_btreeHeight() const { return height; }
+    int get_num_clusters() const { return (int)nodes.size(); }
+
+    // Profundidad máxima del particionado y tamaño a partir del cual un
+    // cluster se divide (maxLevel = 1: un cluster por pivote). Antes de build().
+    void setClustering(int maxLevel_, int maxClusterSize_) {
+        maxLevel       = std::max(1, maxLevel_);
+        maxClusterSize = std::max(1, maxClusterSize_);
+    }
 
     // overridePivots: usar pivotes HFI externos
     void overridePivots(const std::vector<int>& external) {
@@ -150,17 +244,15 @@ public:
         pivotsFixed = true;
     }
 
-    // Build: M-index* con B+-tree + RAF en disco
+    // Build: M-index* con B+-tree en disco
     void build(const std::string& base) {
         using clock = std::chrono::high_resolution_clock;
         auto t0 = clock::now();
 
         // Reset estado
         nodes.clear();
-        btreeIndex.clear();
-        rafOffsets.clear();
-        rafPagesVisited.clear();
-        if (rafIn.is_open()) rafIn.close();
+        pagesVisited.clear();
+        closeBtreeFd();
 
         compDist   = 0;
         pageReads  = 0;
@@ -180,64 +272,44 @@ public:
             }
         }
 
-        // 2) Calcular d+ (máxima distancia observada a cualquier pivot)
-        dplus = 0.0;
-        int sampleSize = std::min(n, 1000);
-        for (int i = 0; i < sampleSize; ++i) {
-            for (int j = 0; j < P; ++j) {
-                double d = distObj(i, pivots[j]);
-                if (d > dplus) dplus = d;
-            }
-        }
-        if (dplus <= 0.0) dplus = 1.0;
-
-        // 3) Calcular mapped keys y distancias para todos los objetos
+        // 2) Distancias de todos los objetos a los pivotes
         std::vector<RAFEntry> entries;
         entries.reserve(n);
 
+        double maxDist = 0.0;
         for (int id = 0; id < n; ++id) {
             RAFEntry entry;
             entry.id = id;
             entry.dists.resize(P);
-
-            double minDist = std::numeric_limits<double>::infinity();
-            int nearestPivot = 0;
-
             for (int j = 0; j < P; ++j) {
                 entry.dists[j] = distObj(id, pivots[j]);
-                if (entry.dists[j] < minDist) {
-                    minDist = entry.dists[j];
-                    nearestPivot = j;
-                }
+                maxDist = std::max(maxDist, entry.dists[j]);
             }
-
-            // M-index* key mapping: key(o) = d(pi, o) + i * d+
-            entry.key = entry.dists[nearestPivot] + nearestPivot * dplus;
+            entry.key = 0.0;
             entries.push_back(std::move(entry));
         }
 
-        // 4) Ordenar por key para B+-tree
+        // 3) d+: un poco por encima de la máxima distancia, para que los
+        //    intervalos de keys de clusters distintos no se toquen
+        dplus = maxDist > 0.0 ? maxDist * (1.0 + 1e-6) : 1.0;
+
+        // 4) Particionado recursivo de Voronoi; asigna las keys
+        //    key(o) = d(p_i0, o) + code(i0, i1, ...) * d+
+        buildClusterTree(entries);
+
+        // 5) Ordenar por key para B+-tree
         std::sort(entries.begin(), entries.end(),
                   [](const RAFEntry& a, const RAFEntry& b) {
                       return a.key < b.key;
                   });
 
-        btreeIndex.clear();
-        for (const auto& entry : entries) {
-            btreeIndex[entry.key].push_back(entry);
-        }
-
-        // 6) Construir cluster "tree" (aquí: un nodo hoja por pivot)
-        buildClusterTree(entries);
-
-        // 7) Escribir RAF en disco
-        rafPath = base + ".midx_raf";
-        writeRAF(entries);
+        // 6) Escribir el B+-tree en disco y abrirlo para las queries
+        btreePath = base + ".midx_btree";
+        writeBTree(entries);
 
-        // 8) Abrir RAF para lecturas en queries
-        rafIn.open(rafPath, std::ios::binary);
-        if (!rafIn) {
-            throw std::runtime_error("MIndex_Improved: cannot open RAF for reading");
+        btreeFd = ::open(btreePath.c_str(), O_RDONLY);
+        if (btreeFd < 0) {
+            throw std::runtime_error("MIndex_Improved: cannot open B+-tree for reading");
         }
 
         auto t1 = clock::now();
@@ -246,73 +318,221 @@ public:
     }
 
 private:
-    // Construir "cluster tree"
-    void buildClusterTree(const std::vector<RAFEntry>& entries) {
+    // Construir el árbol de clusters. Cada objeto se ordena por cercanía a
+    // los pivotes (i0, i1, ...); el nivel l agrupa por i_l dentro del
+    // cluster padre. La key codifica el camino en base P con maxLevel
+    // dígitos (los niveles no usados valen 0): como las hojas no son
+    // prefijo unas de otras, sus intervalos de keys son disjuntos.
+    void buildClusterTree(std::vector<RAFEntry>& entries) {
         nodes.clear();
+        roots.clear();
+
+        int levels = std::min(maxLevel, P);
+        std::vector<std::vector<int>> order(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            std::vector<int> perm(P);
+            for (int j = 0; j < P; ++j) perm[j] = j;
+            const auto& d = entries[i].dists;
+            std::partial_sort(perm.begin(), perm.begin() + levels, perm.end(),
+                              [&](int x, int y) { return d[x] < d[y] || (d[x] == d[y] && x < y); });
+            perm.resize(levels);
+            order[i] = std::move(perm);
+        }
 
-        // Crear un cluster por pivot
-        for (int pIdx = 0; pIdx < P; ++pIdx) {
-            std::vector<const RAFEntry*> clusterEntries;
-
-            for (const auto& entry : entries) {
-                // Encontrar pivot más cercano de este entry
-                double minD = std::numeric_limits<double>::infinity();
-                int nearest = 0;
-                for (int j = 0; j < P; ++j) {
-                    if (entry.dists[j] < minD) {
-                        minD = entry.dists[j];
-                        nearest = j;
-                    }
-                }
-                if (nearest == pIdx) {
-                    clusterEntries.push_back(&entry);
-                }
-            }
+        std::vector<std::vector<int>> groups(P);
+        for (size_t i = 0; i < entries.size(); ++i)
+            groups[order[i][0]].push_back((int)i);
 
-            if (clusterEntries.empty()) continue;
+        std::vector<int> path;
+        for (int pIdx = 0; pIdx < P; ++pIdx) {
+            if (groups[pIdx].empty()) continue;
+            path.assign(1, pIdx);
+            roots.push_back(buildCluster(entries, order, groups[pIdx], path, levels));
+        }
+    }
 
-            ClusterNode node;
-            node.isLeaf = true;
+    // Crea el cluster del camino 'path' con los objetos 'members' y devuelve su índice
+    int32_t buildCluster(std::vector<RAFEntry>& entries,
+                         const std::vector<std::vector<int>>& order,
+                         const std::vector<int>& members,
+                         std::vector<int>& path, int levels)
+    {
+        int32_t idx = (int32_t)nodes.size();
+        nodes.emplace_back();
+        {
+            ClusterNode& node = nodes[idx];
+            node.count = (int32_t)members.size();
             node.minDist.assign(P, std::numeric_limits<double>::infinity());
             node.maxDist.assign(P, -std::numeric_limits<double>::infinity());
-            node.minkey = clusterEntries.front()->key;
-            node.maxkey = clusterEntries.back()->key;
-            node.count  = (int32_t)clusterEntries.size();
 
             // Calcular MBB
-            for (const auto* e : clusterEntries) {
+            for (int m : members) {
                 for (int j = 0; j < P; ++j) {
-                    node.minDist[j] = std::min(node.minDist[j], e->dists[j]);
-                    node.maxDist[j] = std::max(node.maxDist[j], e->dists[j]);
+                    node.minDist[j] = std::min(node.minDist[j], entries[m].dists[j]);
+                    node.maxDist[j] = std::max(node.maxDist[j], entries[m].dists[j]);
                 }
             }
+        }
+
+        int level = (int)path.size();
+        if ((int)members.size() <= maxClusterSize || level >= levels) {
+            // Hoja: asignar keys
+            double code = 0.0;
+            for (int l = 0; l < levels; ++l)
+                code = code * P + (l < level ? path[l] : 0);
+
+            ClusterNode& node = nodes[idx];
+            node.isLeaf  = true;
+            node.pivot   = path[0];
+            node.keyBase = code * dplus;
+            node.minkey = std::numeric_limits<double>::infinity();
+            node.maxkey = -std::numeric_limits<double>::infinity();
+            for (int m : members) {
+                RAFEntry& e = entries[m];
+                e.key = e.dists[path[0]] + node.keyBase;
+                node.minkey = std::min(node.minkey, e.key);
+                node.maxkey = std::max(node.maxkey, e.key);
+            }
+            return idx;
+        }
+
+        // Interno: dividir por el pivote del siguiente nivel
+        std::vector<std::vector<int>> groups(P);
+        for (int m : members)
+            groups[order[m][level]].push_back(m);
 
-            nodes.push_back(std::move(node));
+        std::vector<int32_t> children;
+        for (int pIdx = 0; pIdx < P; ++pIdx) {
+            if (groups[pIdx].empty()) continue;
+            path.push_back(pIdx);
+            children.push_back(buildCluster(entries, order, groups[pIdx], path, levels));
+            path.pop_back();
         }
+
+        ClusterNode& node = nodes[idx];
+        node.isLeaf   = false;
+        node.children = std::move(children);
+        node.minkey   = nodes[node.children.front()].minkey;
+        node.maxkey   = nodes[node.children.back()].maxkey;
+        return idx;
     }
 
-    // Escribir RAF con id, distancias a pivotes y key
-    // y registrar offsets por id
-    void writeRAF(const std::vector<RAFEntry>& entries) {
-        rafOffsets.clear();
+    // Cota inferior de d(q, o) para todo o del cluster (MBB de distancias a pivotes)
+    double clusterLB(const ClusterNode& node, const std::vector<double>& dq) const {
+        double lb = 0.0;
+        for (int j = 0; j < P; ++j) {
+            if (dq[j] < node.minDist[j]) {
+                lb = std::max(lb, node.minDist[j] - dq[j]);
+            } else if (dq[j] > node.maxDist[j]) {
+                lb = std::max(lb, dq[j] - node.maxDist[j]);
+            }
+        }
+        return lb;
+    }
 
-        std::ofstream outf(rafPath, std::ios::binary | std::ios::trunc);
-        if (!outf) throw std::runtime_error("MIndex_Improved: cannot write RAF");
+    // Keys de la hoja con d(p_i0, o) ∈ [d(q,p_i0) ± r]. La key guardada,
+    // fl(d + keyBase), se redondea por otro camino que estos extremos, así
+    // que el tramo se ensancha unos ulp hacia fuera para no perder objetos
+    // en el borde (los de más los descarta el Lemma 4.3).
+    void leafKeyWindow(const ClusterNode& node, double dqi, double r,
+                       double& lo, double& hi) const {
+        const double inf = std::numeric_limits<double>::infinity();
+        double slack = 4 * std::numeric_limits<double>::epsilon() * (node.keyBase + dqi + r);
+        lo = std::max(node.minkey, std::nextafter(node.keyBase + dqi - r - slack, -inf));
+        hi = std::min(node.maxkey, std::nextafter(node.keyBase + dqi + r + slack, inf));
+    }
 
-        for (const auto& entry : entries) {
-            std::streampos pos = outf.tellp();
-            rafOffsets[entry.id] = pos;
+    // Bulk-loading del B+-tree: hojas llenas en orden de key y niveles
+    // internos de abajo hacia arriba. Todo se escribe de una vez.
+    void writeBTree(const std::vector<RAFEntry>& entries) {
+        recordSize = sizeof(double) * (1 + P) + sizeof(int32_t);
+        leafCap    = (PAGE_SIZE - sizeof(PageHeader)) / recordSize;
+        innerCap   = (PAGE_SIZE - sizeof(PageHeader)) / (sizeof(double) + sizeof(int32_t));
+        if (leafCap < 2)
+            throw std::runtime_error("MIndex_Improved: too many pivots for a B+-tree page");
+        pageBuf.assign(PAGE_SIZE, 0);
+
+        std::vector<char> file(PAGE_SIZE, 0);   // página 0: cabecera
+        auto newPage = [&]() {
+            file.resize(file.size() + PAGE_SIZE, 0);
+            return (int32_t)(file.size() / PAGE_SIZE - 1);
+        };
+        auto pagePtr = [&](int32_t page) { return file.data() + (size_t)page * PAGE_SIZE; };
+
+        // Hojas
+        std::vector<std::pair<double,int32_t>> level;   // (primera key, página)
+        for (size_t i = 0; i < entries.size(); i += leafCap) {
+            size_t cnt = std::min(leafCap, entries.size() - i);
+            int32_t page = newPage();
+            if (!level.empty()) {
+                PageHeader prev;
+                std::memcpy(&prev, pagePtr(level.back().second), sizeof(PageHeader));
+                prev.next = page;
+                std::memcpy(pagePtr(level.back().second), &prev, sizeof(PageHeader));
+            }
 
-            outf.write((char*)&entry.id, sizeof(int32_t));
-            for (int j = 0; j < P; ++j) {
-                outf.write((char*)&entry.dists[j], sizeof(double));
+            PageHeader h{1, 0, (uint16_t)cnt, -1};
+            char* buf = pagePtr(page);
+            std::memcpy(buf, &h, sizeof(PageHeader));
+            char* rec = buf + sizeof(PageHeader);
+            for (size_t t = 0; t < cnt; ++t, rec += recordSize) {
+                const RAFEntry& e = entries[i + t];
+                std::memcpy(rec, &e.key, sizeof(double));
+                std::memcpy(rec + sizeof(double), e.dists.data(), P * sizeof(double));
+                std::memcpy(rec + (1 + P) * sizeof(double), &e.id, sizeof(int32_t));
+            }
+            level.push_back({entries[i].key, page});
+        }
+        if (level.empty()) {
+            // índice vacío: una hoja sin entradas
+            int32_t page = newPage();
+            PageHeader h{1, 0, 0, -1};
+            std::memcpy(pagePtr(page), &h, sizeof(PageHeader));
+            level.push_back({0.0, page});
+        }
+        int32_t firstLeaf = level.front().second;
+
+        // Niveles internos
+        height = 1;
+        while (level.size() > 1) {
+            std::vector<std::pair<double,int32_t>> upper;
+            for (size_t i = 0; i < level.size(); i += innerCap) {
+                size_t cnt = std::min(innerCap, level.size() - i);
+                int32_t page = newPage();
+                PageHeader h{0, 0, (uint16_t)cnt, -1};
+                char* buf  = pagePtr(page);
+                char* keys = buf + sizeof(PageHeader);
+                char* kids = keys + innerCap * sizeof(double);
+                std::memcpy(buf, &h, sizeof(PageHeader));
+                for (size_t t = 0; t < cnt; ++t) {
+                    std::memcpy(keys + t * sizeof(double), &level[i + t].first, sizeof(double));
+                    std::memcpy(kids + t * sizeof(int32_t), &level[i + t].second, sizeof(int32_t));
+                }
+                upper.push_back({level[i].first, page});
             }
-            outf.write((char*)&entry.key, sizeof(double));
+            level.swap(upper);
+            height++;
         }
+        rootPage = level.front().second;
+
+        BTreeHeader hdr;
+        std::memset(&hdr, 0, sizeof(BTreeHeader));
+        std::memcpy(hdr.magic, "MIDXBT1", 8);
+        hdr.P         = P;
+        hdr.rootPage  = rootPage;
+        hdr.height    = height;
+        hdr.firstLeaf = firstLeaf;
+        hdr.pageCount = (int32_t)(file.size() / PAGE_SIZE);
+        hdr.entries   = (int64_t)entries.size();
+        std::memcpy(file.data(), &hdr, sizeof(BTreeHeader));
+
+        std::ofstream outf(btreePath, std::ios::binary | std::ios::trunc);
+        if (!outf) throw std::runtime_error("MIndex_Improved: cannot write B+-tree");
+        outf.write(file.data(), (std::streamsize)file.size());
         outf.close();
+        if (!outf) throw std::runtime_error("MIndex_Improved: B+-tree write failed");
 
-        // Aproximación grosera de páginas escritas
-        pageWrites += (long long)(entries.size() / 100) + 1;
+        pageWrites += (long long)(file.size() / PAGE_SIZE);
     }
 
 public:
@@ -328,7 +548,7 @@ public:
             return;
         }
 
-        rafPagesVisited.clear();
+        pagesVisited.clear();
 
         // Distancias q -> pivotes (cuentan en compDist)
         std::vector<double> dq(P);
@@ -336,58 +556,49 @@ public:
             dq[j] = distObj(qId, pivots[j]);
         }
 
-        // Recorremos clusters
-        for (const auto& node : nodes) {
-            double clusterLB = 0.0;
-            for (int j = 0; j < P; ++j) {
-                if (dq[j] < node.minDist[j]) {
-                    clusterLB = std::max(clusterLB, node.minDist[j] - dq[j]);
-                } else if (dq[j] > node.maxDist[j]) {
-                    clusterLB = std::max(clusterLB, dq[j] - node.maxDist[j]);
-                }
-            }
-            if (clusterLB > R) {
+        // Recorremos el árbol de clusters
+        std::vector<int32_t> stack(roots.rbegin(), roots.rend());
+        while (!stack.empty()) {
+            const auto& node = nodes[stack.back()];
+            stack.pop_back();
+
+            if (clusterLB(node, dq) > R) {
                 // bola B(q,R) no puede intersectar ningún objeto del cluster
                 continue;
             }
+            if (!node.isLeaf) {
+                stack.insert(stack.end(), node.children.rbegin(), node.children.rend());
+                continue;
+            }
 
-            // Buscamos entradas en el rango de keys del cluster
-            auto itLow  = btreeIndex.lower_bound(node.minkey);
-            auto itHigh = btreeIndex.upper_bound(node.maxkey);
-
-            for (auto it = itLow; it != itHigh; ++it) {
-                for (const auto& entry : it->second) {
-                    // Lemma 4.5: validación directa
-                    bool validated = false;
-                    for (int j = 0; j < P && !validated; ++j) {
-                        if (entry.dists[j] <= R - dq[j]) {
-                            validated = true;
-                            out.push_back(entry.id);
-                        }
-                    }
-                    if (validated) continue;
-
-                    // Lemma 4.3: pruning
-                    bool objectPruned = false;
-                    for (int j = 0; j < P && !objectPruned; ++j) {
-                        if (std::fabs(entry.dists[j] - dq[j]) > R) {
-                            objectPruned = true;
-                        }
+            // Intervalo de keys del cluster acotado a d(p_i0, o) ∈ [d(q,p_i0) ± R]:
+            // un recorrido secuencial de hojas
+            double lo, hi;
+            leafKeyWindow(node, dq[node.pivot], R, lo, hi);
+            scanKeyRange(lo, hi, [&](int32_t id, const double* dists) {
+                // Lemma 4.5: validación directa
+                for (int j = 0; j < P; ++j) {
+                    if (dists[j] <= R - dq[j]) {
+                        out.push_back(id);
+                        return;
                     }
-                    if (objectPruned) continue;
+                }
 
-                    // Caso ambiguo: acceso a disco + distancia real d(q,o)
-                    touchRAF(entry.id);          // marca página y lee registro
-                    double d = distObj(qId, entry.id);
-                    if (d <= R) {
-                        out.push_back(entry.id);
-                    }
+                // Lemma 4.3: pruning
+                for (int j = 0; j < P; ++j) {
+                    if (std::fabs(dists[j] - dq[j]) > R) return;
                 }
-            }
+
+                // Caso ambiguo: distancia real d(q,o)
+                double d = distObj(qId, id);
+                if (d <= R) {
+                    out.push_back(id);
+                }
+            });
         }
 
-        // páginas físicas de datos tocadas en esta consulta
-        pageReads += (long long)rafPagesVisited.size();
+        // páginas del B+-tree tocadas en esta consulta
+        pageReads += (long long)pagesVisited.size();
 
         auto t1 = clock::now();
         queryTime += std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
@@ -406,7 +617,7 @@ public:
             return;
         }
 
-        rafPagesVisited.clear();
+        pagesVisited.clear();
 
         // Precompute distances from q to pivots
         std::vector<double> dq(P);
@@ -429,22 +640,9 @@ public:
             std::greater<ClusterCandidate>
         > pq;
 
-        // Compute lower bound for each cluster and add to queue
-        for (size_t i = 0; i < nodes.size(); ++i) {
-            const auto& node = nodes[i];
-
-            double lb = 0.0;
-            for (int j = 0; j < P; ++j) {
-                double delta = 0.0;
-                if (dq[j] < node.minDist[j]) {
-                    delta = node.minDist[j] - dq[j];
-                } else if (dq[j] > node.maxDist[j]) {
-                    delta = dq[j] - node.maxDist[j];
-                }
-                if (delta > lb) lb = delta;
-            }
-
-            pq.push({(int)i, lb});
+        // Top-level clusters; internal clusters push their children when popped
+        for (int32_t r : roots) {
+            pq.push({r, clusterLB(nodes[r], dq)});
         }
 
         // k-NN heap (max-heap de k mejores)
@@ -461,43 +659,43 @@ public:
             }
 
             const auto& node = nodes[cand.nodeIdx];
+            if (!node.isLeaf) {
+                for (int32_t c : node.children) {
+                    pq.push({c, std::max(cand.lowerBound, clusterLB(nodes[c], dq))});
+                }
+                continue;
+            }
 
-            auto itLow  = btreeIndex.lower_bound(node.minkey);
-            auto itHigh = btreeIndex.upper_bound(node.maxkey);
-
-            for (auto it = itLow; it != itHigh; ++it) {
-                for (const auto& entry : it->second) {
-                    // Pruning rápido usando Lemma 4.3 con radioK
-                    if (std::isfinite(radiusK)) {
-                        bool pruned = false;
-                        for (int j = 0; j < P && !pruned; ++j) {
-                            if (std::fabs(entry.dists[j] - dq[j]) > radiusK) {
-                                pruned = true;
-                            }
-                        }
-                        if (pruned) continue;
+            double lo = node.minkey, hi = node.maxkey;
+            if (std::isfinite(radiusK)) {
+                leafKeyWindow(node, dq[node.pivot], radiusK, lo, hi);
+            }
+            scanKeyRange(lo, hi, [&](int32_t id, const double* dists) {
+                // Pruning rápido usando Lemma 4.3 con radioK
+                if (std::isfinite(radiusK)) {
+                    for (int j = 0; j < P; ++j) {
+                        if (std::fabs(dists[j] - dq[j]) > radiusK) return;
                     }
+                }
 
-                    // Acceso a RAF + distancia real
-                    touchRAF(entry.id);
-                    double d = distObj(qId, entry.id);
-
-                    if ((int)knnHeap.size() < k) {
-                        knnHeap.push({d, entry.id});
-                        if ((int)knnHeap.size() == k) {
-                            radiusK = knnHeap.top().first;
-                        }
-                    } else if (d < radiusK) {
-                        knnHeap.pop();
-                        knnHeap.push({d, entry.id});
+                // Distancia real
+                double d = distObj(qId, id);
+
+                if ((int)knnHeap.size() < k) {
+                    knnHeap.push({d, id});
+                    if ((int)knnHeap.size() == k) {
                         radiusK = knnHeap.top().first;
                     }
+                } else if (d < radiusK) {
+                    knnHeap.pop();
+                    knnHeap.push({d, id});
+                    radiusK = knnHeap.top().first;
                 }
-            }
+            });
         }
 
-        // páginas físicas de datos tocadas en esta consulta
-        pageReads += (long long)rafPagesVisited.size();
+        // páginas del B+-tree tocadas en esta consulta
+        pageReads += (long long)pagesVisited.size();
 
         // Extraer resultados ordenados por distancia ascendente
         while (!knnHeap.empty()) {
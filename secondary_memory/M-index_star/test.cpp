@@ -1,5 +1,6 @@
 #include <bits/stdc++.h>
 #include "mindex.hpp"
+#include "../buffer_pool.hpp"
 #include "../../objectdb.hpp"
 #include "../../datasets/paths.hpp"
 
@@ -12,6 +13,15 @@ static const vector<int>    K_VALUES      = {5, 10, 20, 50, 100};
 // Para memoria secundaria
 static const int NUM_PIVOTS_DISK = 5;
 
+// Particionado recursivo del M-index: niveles máximos y tamaño a partir
+// del cual un cluster se divide por el siguiente pivote más cercano
+static const int MAX_LEVEL        = 3;
+static const int MAX_CLUSTER_SIZE = 256;
+
+// Buffer pool compartido: presupuesto en páginas de 4KB (0 = sin caché)
+static const size_t BUFFER_POOL_PAGES = 1024;
+static const BufferPool::Policy BUFFER_POOL_POLICY = BufferPool::Policy::LRU;
+
 // Autodetección 0-based / 1-based para IDs (igual que en otros tests)
 vector<int> auto_fix_ids(const vector<int> &ids, int nObjects) {
     if (ids.empty()) return ids;
@@ -142,8 +152,13 @@ void test_dataset(const string& dataset) {
     }
     pivots.resize(NUM_PIVOTS_DISK);
 
+    // caché caliente a lo largo de todas las consultas del dataset
+    // (declarado antes del índice: debe sobrevivirlo)
+    BufferPool pool(BUFFER_POOL_PAGES, 4096, BUFFER_POOL_POLICY);
+
     MIndex_Improved midx(db.get(), NUM_PIVOTS_DISK);
     midx.overridePivots(pivots);
+    midx.setClustering(MAX_LEVEL, MAX_CLUSTER_SIZE);
     string base = "midx_indexes/" + dataset + "_p5";
 
     t0 = chrono::high_resolution_clock::now();
@@ -154,6 +169,8 @@ void test_dataset(const string& dataset) {
 
     cout << "[BUILD] Tiempo: " << buildTime << " ms\n";
 
+    midx.attachBufferPool(&pool);
+
     cout << "\n[EXP MRQ] Variando SELECTIVIDAD (P=5 fijo)\n";
 
     for (double selectivity : SELECTIVITIES) {
@@ -164,6 +181,7 @@ void test_dataset(const string& dataset) {
 
         double radius = radii[selectivity];
         long long totalD = 0, totalT = 0, totalPages = 0;
+        pool.reset_stats();
 
         cout << "  sel=" << selectivity << " (R=" << radius << ")... " << flush;
 
@@ -202,6 +220,10 @@ void test_dataset(const string& dataset) {
           << "\"compdists\":" << avgD << ","
           << "\"time_ms\":" << avgTms << ","
           << "\"pages\":" << avgPA << ","
+          << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+          << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+          << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+          << "\"hit_rate\":" << pool.get_hitRate() << ","
           << "\"n_queries\":" << queries.size() << ","
           << "\"run_id\":1"
           << "}";
@@ -214,6 +236,7 @@ void test_dataset(const string& dataset) {
 
     for (int k : K_VALUES) {
         long long totalD = 0, totalT = 0, totalPages = 0;
+        pool.reset_stats();
 
         cout << "  k=" << k << "... " << flush;
 
@@ -252,6 +275,10 @@ void test_dataset(const string& dataset) {
           << "\"compdists\":" << avgD << ","
           << "\"time_ms\":" << avgTms << ","
           << "\"pages\":" << avgPA << ","
+          << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+          << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+          << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+          << "\"hit_rate\":" << pool.get_hitRate() << ","
           << "\"n_queries\":" << queries.size() << ","
           << "\"run_id\":1"
           << "}";
@@ -2,6 +2,7 @@
 #define MBPT_DISK_HPP
 
 #include "../../objectdb.hpp"
+#include "../buffer_pool.hpp"
 #include <vector>
 #include <algorithm>
 #include <random>
@@ -12,14 +13,24 @@
 #include <chrono>
 #include <stdexcept>
 #include <queue>
-#include <map>
 #include <set>
+#include <unordered_set>
 #include <iostream>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 class MBPT_Disk {
 public:
     static constexpr int DEFAULT_PAGE_BYTES = 4096;
     static constexpr int DEFAULT_LEAF_CAP = 50;
+    static constexpr int MAX_DEPTH = 30;   // blockValue (numeración de heap) cabe en 31 bits
+    static constexpr size_t PAR_GRAIN = 1024; // mínimo de objetos por hilo en el build paralelo
 
     // Entrada en RAF
     struct RAFEntry {
@@ -31,7 +42,7 @@ public:
     struct BlockNode {
         bool isLeaf;
         int level;
-        int blockValue;           // partition key acumulada (path in tree)
+        int blockValue;           // partition key: path en numeración de heap (raíz = 1)
         int center = -1;          // partition center c
         double dmed = 0.0;        // medium distance
         double rho = 0.0;         // ρ parameter para ρ-split
@@ -44,7 +55,7 @@ public:
 
     struct LeafInfo {
         int32_t blockValue;
-        int64_t offset;
+        int32_t node;             // BlockNode de la hoja
         int32_t count;
     };
 
@@ -56,24 +67,60 @@ private:
     int pagesPerNode;
     double rho;  // p global para todas las ρ-split functions
 
+    // ---- B+-tree en disco ----
+    // Las hojas son las páginas del RAF (<base>.mbpt_raf): entradas
+    // ordenadas por key, rafPerPage por página. Los niveles internos van
+    // en <base>.mbpt_btree: página 0 = cabecera; cada nodo interno es
+    // PageHeader + keys (uint64) + hijos (int32), donde keys[i] es la
+    // primera key del subárbol hijos[i]. En el último nivel interno los
+    // hijos son números de página del RAF.
+    struct BTreeHeader {
+        char    magic[8];    // "MBPTBT1"
+        int32_t rootPage;    // con height = 1, página del RAF
+        int32_t height;      // 1 = la raíz es hoja
+        int32_t innerCap;
+        int32_t pageCount;
+        int64_t entries;
+    };
+
+    struct PageHeader {
+        uint8_t  isLeaf;
+        uint8_t  pad;
+        uint16_t count;
+        int32_t  next;
+    };
+
     // Estructuras de datos
     std::vector<BlockNode> blockNodes;
     std::vector<LeafInfo> leaves;
-    std::vector<RAFEntry> rafEntries;  // RAF in-memory (sorted by key)
-    
-    // B+-tree: map ordenado key -> object ids
-    std::multimap<uint64_t, int32_t> btreeIndex;
+    int64_t rafCount   = 0;   // entradas del RAF
+    int     rafPerPage = 0;   // entradas del RAF por página
+    int32_t rootPage   = -1;
+    int     height     = 0;
+    int     innerCap   = 0;   // hijos por nodo interno
 
     // Archivos
     std::string rafPath;
     std::string idxPath;
-    mutable FILE* rafFp = nullptr;
+    std::string btreePath;
+    int rafFd   = -1;
+    int btreeFd = -1;
+    BufferPool* pool = nullptr;   // caché de páginas del RAF y del B+-tree (opcional)
+    mutable std::vector<RAFEntry> rafBuf;
+    mutable std::vector<char> pageBuf;
+    // páginas tocadas en la consulta: RAF >= 0, B+-tree como -(page+1)
+    mutable std::unordered_set<int64_t> pagesVisited;
+
+    // Build paralelo: hilos totales y cuántos quedan libres
+    int buildThreads;
+    std::atomic<int> freeWorkers{0};
 
     // Métricas
     mutable long long compDist = 0;
     mutable long long pageReads = 0;
     mutable long long pageWrites = 0;
     mutable long long queryTime = 0;
+    mutable std::atomic<long long> buildDist{0};   // distancias del build (todos los hilos)
 
 public:
     MBPT_Disk(const ObjectDB* db_, double rho_ = 0.0, int pageBytes_ = DEFAULT_PAGE_BYTES, int leafCap_ = DEFAULT_LEAF_CAP)
@@ -81,12 +128,30 @@ public:
     {
         if (!db) throw std::runtime_error("DB null");
         pagesPerNode = std::max<int>(1, pageBytes / 4096);
+        buildThreads = std::max<int>(1, (int)std::thread::hardware_concurrency());
     }
 
     ~MBPT_Disk() {
-        if (rafFp) fclose(rafFp);
+        closeFiles();
     }
 
+    MBPT_Disk(const MBPT_Disk&) = delete;
+    MBPT_Disk& operator=(const MBPT_Disk&) = delete;
+
+    // Lecturas del RAF y del B+-tree a través de un buffer pool compartido
+    // (nullptr = pread). El pool debe vivir más que el índice.
+    void attachBufferPool(BufferPool* pool_) {
+        if (pool) {
+            if (rafFd >= 0)   pool->invalidate(rafFd);
+            if (btreeFd >= 0) pool->invalidate(btreeFd);
+        }
+        pool = pool_;
+    }
+
+    // Hilos usados por build() (1 = secuencial). Por defecto, todos los núcleos.
+    void setBuildThreads(int t) { buildThreads = std::max(1, t); }
+    int get_buildThreads() const { return buildThreads; }
+
     void clear_counters() const { compDist = pageReads = pageWrites = queryTime = 0; }
     long long get_compDist()  const { return compDist; }
     long long get_pageReads() const { return pageReads; }
@@ -96,6 +161,7 @@ public:
     // DEBUG: métodos temporales para diagnóstico
     size_t debug_get_blockNodes_size() const { return blockNodes.size(); }
     size_t debug_get_leaves_size() const { return leaves.size(); }
+    int get_btreeHeight() const { return height; }
     void debug_print_root() const {
         if (!blockNodes.empty()) {
             const auto& root = blockNodes[0];
@@ -110,6 +176,114 @@ private:
         return db->distance(a,b);
     }
 
+    // Distancia durante el build: puede llamarse desde varios hilos
+    inline double distBuild(int a, int b) const {
+        buildDist.fetch_add(1, std::memory_order_relaxed);
+        return db->distance(a,b);
+    }
+
+    // Reserva hasta 'want' hilos libres del presupuesto del build
+    int acquireWorkers(int want) {
+        int f = freeWorkers.load();
+        while (want > 0 && f > 0) {
+            int take = std::min(f, want);
+            if (freeWorkers.compare_exchange_weak(f, f - take)) return take;
+        }
+        return 0;
+    }
+
+    void releaseWorkers(int k) { if (k > 0) freeWorkers.fetch_add(k); }
+
+    // Hilos del build: se unen siempre antes de salir del ámbito (también si
+    // el hilo actual lanza una excepción, p.ej. bad_alloc) y join() relanza
+    // la primera excepción de un hilo en el que los espera.
+    class TaskGroup {
+        std::vector<std::thread> threads;
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        void joinAll() {
+            for (std::thread& t : threads)
+                if (t.joinable()) t.join();
+            threads.clear();
+        }
+
+    public:
+        TaskGroup() = default;
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+        ~TaskGroup() { joinAll(); }
+
+        template <class F>
+        void run(F&& f) {
+            threads.emplace_back([this, f = std::forward<F>(f)]() mutable {
+                try {
+                    f();
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) error = std::current_exception();
+                }
+            });
+        }
+
+        bool empty() const { return threads.empty(); }
+
+        void join() {
+            joinAll();
+            if (error) {
+                std::exception_ptr e = error;
+                error = nullptr;
+                std::rethrow_exception(e);
+            }
+        }
+    };
+
+    // f(begin, end) sobre [0, count), repartido en bloques contiguos entre
+    // el hilo actual y los trabajadores libres (al menos PAR_GRAIN por hilo)
+    template <class F>
+    void parallelFor(size_t count, F&& f) {
+        int extra = acquireWorkers((int)std::min<size_t>(count / PAR_GRAIN, (size_t)buildThreads) - 1);
+        if (extra == 0) { f((size_t)0, count); return; }
+
+        size_t parts = (size_t)extra + 1;
+        size_t chunk = (count + parts - 1) / parts;
+        TaskGroup workers;
+        for (size_t p = 1; p < parts; p++) {
+            size_t b = p * chunk, e = std::min(count, b + chunk);
+            if (b < e) workers.run([&f, b, e]() { f(b, e); });
+        }
+        f((size_t)0, std::min(count, chunk));
+        workers.join();
+        releaseWorkers(extra);
+    }
+
+    // Sort por bloques en paralelo y mezcla por parejas (también en paralelo)
+    template <class T, class Cmp>
+    void parallelSort(std::vector<T>& v, Cmp cmp) {
+        int extra = acquireWorkers((int)std::min<size_t>(v.size() / PAR_GRAIN, (size_t)buildThreads) - 1);
+        if (extra == 0) { std::sort(v.begin(), v.end(), cmp); return; }
+
+        size_t parts = (size_t)extra + 1;
+        std::vector<size_t> bounds(parts + 1);
+        for (size_t p = 0; p <= parts; p++) bounds[p] = v.size() * p / parts;
+
+        TaskGroup workers;
+        for (size_t p = 0; p < parts; p++)
+            workers.run([&, p]() { std::sort(v.begin() + bounds[p], v.begin() + bounds[p + 1], cmp); });
+        workers.join();
+
+        for (size_t width = 1; width < parts; width *= 2) {
+            for (size_t p = 0; p + width < parts; p += 2 * width) {
+                size_t mid = bounds[p + width], end = bounds[std::min(parts, p + 2 * width)];
+                workers.run([&, p, mid, end]() {
+                    std::inplace_merge(v.begin() + bounds[p], v.begin() + mid, v.begin() + end, cmp);
+                });
+            }
+            workers.join();
+        }
+        releaseWorkers(extra);
+    }
+
     // Normaliza distancia a Ks bits (para distance key)
     uint32_t normalizeDistance(double dist, double maxDist, int bits = 16) const {
         if (maxDist <= 0.0) return 0;
@@ -143,64 +317,73 @@ public:
         using clock = std::chrono::high_resolution_clock;
         auto t0 = clock::now();
 
+        closeFiles();
         blockNodes.clear();
         leaves.clear();
-        rafEntries.clear();
-        btreeIndex.clear();
         pageWrites = 0;
+        buildDist = 0;
+        freeWorkers = buildThreads - 1;
 
-        rafPath = base + ".mbpt_raf";
-        idxPath = base + ".mbpt_index";
+        rafPath   = base + ".mbpt_raf";
+        idxPath   = base + ".mbpt_index";
+        btreePath = base + ".mbpt_btree";
 
         std::vector<int> objs(n);
         for (int i = 0; i < n; i++) objs[i] = i;
 
-        // Crear raíz del block tree
-        BlockNode root;
-        root.isLeaf = false;
-        root.level = 0;
-        root.blockValue = 0;
-        root.objects = objs;
-        blockNodes.push_back(root);
+        // Construir block tree recursivamente con ρ-split. blockValue en
+        // numeración de heap (raíz 1, hijos 2v y 2v+1): cada hoja tiene una
+        // partition key única aunque las hojas estén a distinta profundidad.
+        buildBlockTree(std::move(objs), 0, 1, blockNodes);
 
-        // Construir block tree recursivamente con ρ-split
-        buildBlockTree(0);
-
-        // Generar RAF entries y B+-tree index
+        // Hojas y su tramo (aún sin ordenar) en rafEntries
+        std::vector<int64_t> leafStart;
+        int64_t total = 0;
         for (size_t i = 0; i < blockNodes.size(); i++) {
             BlockNode& B = blockNodes[i];
             if (!B.isLeaf) continue;
 
             LeafInfo L;
             L.blockValue = B.blockValue;
-            L.offset = rafEntries.size();
+            L.node = (int32_t)i;
             L.count = B.objects.size();
 
-            for (int id : B.objects) {
-                double dist = (B.center >= 0) ? distObj(id, B.center) : 0.0;
-                uint32_t dk = normalizeDistance(dist, B.maxDist);
-                uint64_t key = composeKey(B.blockValue, dk);
-                
-                RAFEntry entry;
-                entry.id = id;
-                entry.key = key;
-                rafEntries.push_back(entry);
-                
-                // Multimap permite múltiples valores por key
-                btreeIndex.insert({key, id});
-            }
-
-            int leafIdx = leaves.size();
+            B.leafIdx = leaves.size();
             leaves.push_back(L);
-            B.leafIdx = leafIdx;
+            leafStart.push_back(total);
+            total += L.count;
+        }
+
+        // Generar RAF entries: las keys de cada hoja son independientes.
+        // Se reparte [0, hojas * leafCap): cada bloque procesa las hojas l
+        // con l * leafCap dentro de él.
+        std::vector<RAFEntry> rafEntries(total);
+        parallelFor(leaves.size() * (size_t)leafCap, [&](size_t b, size_t e) {
+            size_t first = (b + leafCap - 1) / leafCap, last = (e + leafCap - 1) / leafCap;
+            for (size_t l = first; l < last; l++) {
+                const BlockNode& B = blockNodes[leaves[l].node];
+                RAFEntry* entry = rafEntries.data() + leafStart[l];
+                for (int id : B.objects) {
+                    double dist = (B.center >= 0) ? distBuild(id, B.center) : 0.0;
+                    uint32_t dk = normalizeDistance(dist, B.maxDist);
+                    entry->id = id;
+                    entry->key = composeKey(B.blockValue, dk);
+                    entry++;
+                }
+            }
+        });
+        for (BlockNode& B : blockNodes) {
             B.objects.clear();
+            B.objects.shrink_to_fit();
         }
 
         // Ordenar RAF entries por key
-        std::sort(rafEntries.begin(), rafEntries.end(), 
+        parallelSort(rafEntries,
             [](const RAFEntry& a, const RAFEntry& b) { return a.key < b.key; });
 
-        // Escribir RAF a disco
+        // Escribir RAF a disco: son las hojas del B+-tree
+        rafCount   = (int64_t)rafEntries.size();
+        rafPerPage = std::max<int>(1, pageBytes / (int)sizeof(RAFEntry));
         {
             std::ofstream out(rafPath, std::ios::binary | std::ios::trunc);
             if (!out) throw std::runtime_error("cannot write RAF file");
@@ -208,7 +391,10 @@ public:
                 out.write(reinterpret_cast<const char*>(rafEntries.data()), 
                          rafEntries.size() * sizeof(RAFEntry));
         }
-        pageWrites += (long long)rafEntries.size() / (pageBytes / sizeof(RAFEntry)) + 1;
+        pageWrites += (rafCount + rafPerPage - 1) / rafPerPage;
+
+        // Niveles internos del B+-tree
+        writeBTree(rafEntries);
 
         // Escribir index (block tree)
         {
@@ -237,48 +423,62 @@ public:
         }
         pageWrites += (long long)blockNodes.size() * pagesPerNode;
 
-        // Abrir RAF para queries
-        rafFp = std::fopen(rafPath.c_str(), "rb");
-        if (!rafFp) throw std::runtime_error("cannot reopen RAF");
+        // Abrir RAF y B+-tree para queries
+        rafFd   = ::open(rafPath.c_str(), O_RDONLY);
+        btreeFd = ::open(btreePath.c_str(), O_RDONLY);
+        if (rafFd < 0 || btreeFd < 0) throw std::runtime_error("cannot reopen RAF / B+-tree");
+        pageBuf.assign(pageBytes, 0);
+
+        compDist += buildDist.load();
 
         auto t1 = clock::now();
         double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
         std::cerr << "[MBPT] Build OK (" << ms << " ms) blocks=" << blockNodes.size() 
-                  << " leaves=" << leaves.size() << " raf_entries=" << rafEntries.size() << "\n";
+                  << " leaves=" << leaves.size() << " raf_entries=" << rafCount
+                  << " btree_height=" << height << " threads=" << buildThreads << "\n";
     }
 
 private:
-    // Construcción recursiva del block tree con p-split
-    void buildBlockTree(int nodeIdx) {
-        
-        if ((int)blockNodes[nodeIdx].objects.size() <= leafCap) {
-            blockNodes[nodeIdx].isLeaf = true;
+    // Construcción recursiva del block tree con p-split. Añade el subárbol
+    // de 'objs' a 'nodes' (el nodo antes que sus hijos) y devuelve el índice
+    // de su raíz. Los dos hijos son independientes: si hay un trabajador
+    // libre, el derecho se construye en otro hilo sobre su propio vector y
+    // después se anexa.
+    int buildBlockTree(std::vector<int>&& objs, int level, int blockValue, std::vector<BlockNode>& nodes) {
+        BlockNode node;
+        node.isLeaf = false;
+        node.level = level;
+        node.blockValue = blockValue;
+
+        if ((int)objs.size() <= leafCap || level >= MAX_DEPTH) {
+            node.isLeaf = true;
             // Seleccionar center para hoja
-            blockNodes[nodeIdx].center = selectCenter(blockNodes[nodeIdx].objects);
-            blockNodes[nodeIdx].maxDist = computeMaxDist(blockNodes[nodeIdx].objects, blockNodes[nodeIdx].center);
-            return;
+            node.center = selectCenter(objs);
+            node.maxDist = computeMaxDist(objs, node.center);
+            node.objects = std::move(objs);
+            nodes.push_back(std::move(node));
+            return (int)nodes.size() - 1;
         }
 
         // Seleccionar partition center
-        int center = selectCenter(blockNodes[nodeIdx].objects);
-        blockNodes[nodeIdx].center = center;
-        blockNodes[nodeIdx].rho = rho;
+        int center = selectCenter(objs);
+        node.center = center;
+        node.rho = rho;
 
         // Calcular distancias y encontrar mediana
-        std::vector<std::pair<double, int>> distances;
-        distances.reserve(blockNodes[nodeIdx].objects.size());
+        std::vector<std::pair<double, int>> distances(objs.size());
+        parallelFor(objs.size(), [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; i++)
+                distances[i] = {distBuild(objs[i], center), objs[i]};
+        });
         double maxD = 0.0;
-        
-        for (int id : blockNodes[nodeIdx].objects) {
-            double d = distObj(id, center);
-            distances.emplace_back(d, id);
-            if (d > maxD) maxD = d;
-        }
+        for (const auto& de : distances)
+            if (de.first > maxD) maxD = de.first;
         
         std::sort(distances.begin(), distances.end());
         double dmed = distances[distances.size() / 2].first;
-        blockNodes[nodeIdx].dmed = dmed;
-        blockNodes[nodeIdx].maxDist = maxD;
+        node.dmed = dmed;
+        node.maxDist = maxD;
 
         std::vector<int> leftObjs, rightObjs;
         double threshold = dmed - rho;
@@ -293,60 +493,205 @@ private:
 
         // Si no se puede dividir, convertir en hoja
         if (leftObjs.empty() || rightObjs.empty()) {
-            blockNodes[nodeIdx].isLeaf = true;
-            return;
+            node.isLeaf = true;
+            node.objects = std::move(objs);
+            nodes.push_back(std::move(node));
+            return (int)nodes.size() - 1;
         }
 
-        // Crear nodos hijos - guardar valores antes de push_back
-        int currentBlockValue = blockNodes[nodeIdx].blockValue;
-        int currentLevel = blockNodes[nodeIdx].level;
-        
-        int leftIdx = blockNodes.size();
-        BlockNode leftNode;
-        leftNode.isLeaf = false;
-        leftNode.level = currentLevel + 1;
-        leftNode.blockValue = (currentBlockValue << 1) | 0;
-        leftNode.objects = std::move(leftObjs);
-        blockNodes.push_back(leftNode);
-
-        int rightIdx = blockNodes.size();
-        BlockNode rightNode;
-        rightNode.isLeaf = false;
-        rightNode.level = currentLevel + 1;
-        rightNode.blockValue = (currentBlockValue << 1) | 1;
-        rightNode.objects = std::move(rightObjs);
-        blockNodes.push_back(rightNode);
-
-        blockNodes[nodeIdx].left = leftIdx;
-        blockNodes[nodeIdx].right = rightIdx;
+        int nodeIdx = nodes.size();
+        nodes.push_back(std::move(node));
+        objs.clear();
+        objs.shrink_to_fit();
 
         // Recursión
-        buildBlockTree(leftIdx);
-        buildBlockTree(rightIdx);
+        // (si la rama izquierda lanza, rightTask se une al salir del ámbito)
+        std::vector<BlockNode> rightNodes;
+        TaskGroup rightTask;
+        if (rightObjs.size() >= PAR_GRAIN && acquireWorkers(1) == 1) {
+            rightTask.run([&]() {
+                buildBlockTree(std::move(rightObjs), level + 1, (blockValue << 1) | 1, rightNodes);
+                releaseWorkers(1);
+            });
+        }
+
+        int leftIdx = buildBlockTree(std::move(leftObjs), level + 1, (blockValue << 1) | 0, nodes);
+        int rightIdx;
+        if (!rightTask.empty()) {
+            rightTask.join();
+            rightIdx = nodes.size();
+            for (BlockNode& B : rightNodes) {
+                if (B.left >= 0)  B.left += rightIdx;
+                if (B.right >= 0) B.right += rightIdx;
+                nodes.push_back(std::move(B));
+            }
+        } else {
+            rightIdx = buildBlockTree(std::move(rightObjs), level + 1, (blockValue << 1) | 1, nodes);
+        }
+
+        nodes[nodeIdx].left = leftIdx;
+        nodes[nodeIdx].right = rightIdx;
+        return nodeIdx;
+    }
+
+    void closeFiles() {
+        for (int* fd : {&rafFd, &btreeFd}) {
+            if (*fd < 0) continue;
+            if (pool) pool->invalidate(*fd);
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+
+    // Bulk-loading de los niveles internos sobre las páginas del RAF
+    void writeBTree(const std::vector<RAFEntry>& entries) {
+        innerCap = (pageBytes - (int)sizeof(PageHeader)) / (int)(sizeof(uint64_t) + sizeof(int32_t));
+        if (innerCap < 2) throw std::runtime_error("page too small for B+-tree");
+
+        std::vector<char> file(pageBytes, 0);   // página 0: cabecera
+        auto newPage = [&]() {
+            file.resize(file.size() + pageBytes, 0);
+            return (int32_t)(file.size() / pageBytes - 1);
+        };
+
+        // Nivel hoja: (primera key, página del RAF)
+        std::vector<std::pair<uint64_t,int32_t>> level;
+        for (int64_t i = 0; i < (int64_t)entries.size(); i += rafPerPage)
+            level.push_back({entries[i].key, (int32_t)(i / rafPerPage)});
+
+        height = level.empty() ? 0 : 1;
+        while (level.size() > 1) {
+            std::vector<std::pair<uint64_t,int32_t>> upper;
+            for (size_t i = 0; i < level.size(); i += innerCap) {
+                size_t cnt = std::min<size_t>(innerCap, level.size() - i);
+                int32_t page = newPage();
+                char* buf  = file.data() + (size_t)page * pageBytes;
+                char* keys = buf + sizeof(PageHeader);
+                char* kids = keys + innerCap * sizeof(uint64_t);
+                PageHeader h{0, 0, (uint16_t)cnt, -1};
+                std::memcpy(buf, &h, sizeof(PageHeader));
+                for (size_t t = 0; t < cnt; ++t) {
+                    std::memcpy(keys + t * sizeof(uint64_t), &level[i + t].first, sizeof(uint64_t));
+                    std::memcpy(kids + t * sizeof(int32_t), &level[i + t].second, sizeof(int32_t));
+                }
+                upper.push_back({level[i].first, page});
+            }
+            level.swap(upper);
+            height++;
+        }
+        rootPage = level.empty() ? -1 : level.front().second;
+
+        BTreeHeader hdr;
+        std::memset(&hdr, 0, sizeof(BTreeHeader));
+        std::memcpy(hdr.magic, "MBPTBT1", 8);
+        hdr.rootPage  = rootPage;
+        hdr.height    = height;
+        hdr.innerCap  = innerCap;
+        hdr.pageCount = (int32_t)(file.size() / pageBytes);
+        hdr.entries   = (int64_t)entries.size();
+        std::memcpy(file.data(), &hdr, sizeof(BTreeHeader));
+
+        std::ofstream out(btreePath, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("cannot write B+-tree file");
+        out.write(file.data(), (std::streamsize)file.size());
+        out.close();
+        if (!out) throw std::runtime_error("B+-tree write failed");
+
+        pageWrites += (long long)(file.size() / pageBytes);
+    }
 
-        blockNodes[nodeIdx].objects.clear();
+    // Copia [offset, offset+len) de fd (vía pool si hay)
+    void readAt(int fd, int64_t offset, size_t len, void* dst) const {
+        if (pool) {
+            pool->read(fd, offset, len, dst);
+        } else if (::pread(fd, dst, len, (off_t)offset) != (ssize_t)len) {
+            throw std::runtime_error("MBPT: read failed");
+        }
+    }
+
+    // Baja por los niveles internos hasta la página del RAF donde empieza
+    // (upper = false) o termina (upper = true) el rango de keys que
+    // contiene a 'key'. Las keys repetidas pueden empezar en el hijo anterior.
+    int32_t findLeafPage(uint64_t key, bool upper) const {
+        int32_t page = rootPage;
+        for (int level = height; level > 1; --level) {
+            pagesVisited.insert(-(int64_t)page - 1);
+            readAt(btreeFd, (int64_t)page * pageBytes, pageBytes, pageBuf.data());
+            PageHeader h;
+            std::memcpy(&h, pageBuf.data(), sizeof(PageHeader));
+            const char* keys = pageBuf.data() + sizeof(PageHeader);
+            const char* kids = keys + innerCap * sizeof(uint64_t);
+
+            int idx = 0;
+            for (int i = 1; i < h.count; ++i) {
+                uint64_t k;
+                std::memcpy(&k, keys + i * sizeof(uint64_t), sizeof(uint64_t));
+                if (k < key || (upper && k == key)) idx = i;
+                else break;
+            }
+            std::memcpy(&page, kids + idx * sizeof(int32_t), sizeof(int32_t));
+        }
+        return page;
+    }
+
+    // Entradas [first, first+count) del RAF en una sola lectura
+    void readRAFEntries(int64_t first, int64_t count, std::vector<RAFEntry>& buf) const {
+        buf.resize(count > 0 ? (size_t)count : 0);
+        if (buf.empty()) return;
+        for (int64_t p = first / rafPerPage; p <= (first + count - 1) / rafPerPage; ++p)
+            pagesVisited.insert(p);
+        readAt(rafFd, first * (int64_t)sizeof(RAFEntry), buf.size() * sizeof(RAFEntry), buf.data());
+    }
+
+    // Entradas del RAF con key en [minKey, maxKey]: las páginas hoja entre
+    // las dos bajadas por el B+-tree son un tramo contiguo del archivo
+    void readRAFRange(uint64_t minKey, uint64_t maxKey, std::vector<RAFEntry>& buf) const {
+        buf.clear();
+        if (rootPage < 0 || minKey > maxKey) return;
+        int64_t first = (int64_t)findLeafPage(minKey, false) * rafPerPage;
+        int64_t last  = std::min<int64_t>(((int64_t)findLeafPage(maxKey, true) + 1) * rafPerPage, rafCount);
+        readRAFEntries(first, last - first, buf);
+        buf.erase(std::remove_if(buf.begin(), buf.end(), [&](const RAFEntry& e) {
+                      return e.key < minKey || e.key > maxKey;
+                  }), buf.end());
+    }
+
+    // Posición en el RAF de la primera entrada con key >= 'key'
+    int64_t lowerBoundPos(uint64_t key) const {
+        if (rootPage < 0) return 0;
+        int64_t first = (int64_t)findLeafPage(key, false) * rafPerPage;
+        readRAFEntries(first, std::min<int64_t>(rafPerPage, rafCount - first), rafBuf);
+        auto it = std::lower_bound(rafBuf.begin(), rafBuf.end(), key,
+            [](const RAFEntry& e, uint64_t k) { return e.key < k; });
+        return first + (int64_t)(it - rafBuf.begin());
     }
 
     // Selecciona center heurísticamente
-    int selectCenter(const std::vector<int>& objs) const {
+    int selectCenter(const std::vector<int>& objs) {
         if (objs.empty()) return -1;
         
         static thread_local std::mt19937_64 rng{std::random_device{}()};
         std::uniform_int_distribution<size_t> dist(0, objs.size() - 1);
         
-        // Heurística: elegir objeto aleatorio y buscar el más lejano
-        int center = objs[dist(rng)];
-        double maxD = -1.0;
-        
-        for (int id : objs) {
-            double d = distObj(center, id);
-            if (d > maxD) {
-                maxD = d;
-                center = id;
+        // Heurística: el objeto más lejano a un inicio aleatorio (el primero
+        // en orden si hay empate), buscado en paralelo por bloques
+        int start = objs[dist(rng)];
+        // máximo por bloque; cada bloque tiene al menos PAR_GRAIN objetos,
+        // así que b / PAR_GRAIN identifica al bloque
+        size_t parts = objs.size() / PAR_GRAIN + 1;
+        std::vector<std::pair<double, int>> best(parts, {-1.0, start});
+        parallelFor(objs.size(), [&](size_t b, size_t e) {
+            std::pair<double, int>& local = best[b / PAR_GRAIN];
+            for (size_t i = b; i < e; i++) {
+                double d = distBuild(start, objs[i]);
+                if (d > local.first) local = {d, objs[i]};
             }
-        }
-        
-        return center;
+        });
+
+        std::pair<double, int> center = {-1.0, start};
+        for (const auto& p : best)
+            if (p.first > center.first) center = p;
+        return center.second;
     }
 
     double computeMaxDist(const std::vector<int>& objs, int center) const {
@@ -354,7 +699,7 @@ private:
         
         double maxD = 0.0;
         for (int id : objs) {
-            double d = distObj(center, id);
+            double d = distBuild(center, id);
             if (d > maxD) maxD = d;
         }
         return maxD > 0.0 ? maxD : 1.0;
@@ -367,6 +712,8 @@ public:
         auto t0 = clock::now();
         out.clear();
 
+        pagesVisited.clear();
+
         // Atravesar block tree usando Lemma 4.7
         std::vector<int> candidateLeaves;
         traverseBlockTree(0, qId, R, candidateLeaves);
@@ -376,19 +723,8 @@ public:
             if (leafIdx < 0 || leafIdx >= (int)leaves.size()) continue;
             
             const LeafInfo& L = leaves[leafIdx];
-            
-            // Encontrar el BlockNode correspondiente
-            int blockNodeIdx = -1;
-            for (size_t i = 0; i < blockNodes.size(); i++) {
-                if (blockNodes[i].isLeaf && blockNodes[i].leafIdx == leafIdx) {
-                    blockNodeIdx = i;
-                    break;
-                }
-            }
-            
-            if (blockNodeIdx < 0 || blockNodes[blockNodeIdx].center < 0) continue;
-            
-            const BlockNode& B = blockNodes[blockNodeIdx];
+            const BlockNode& B = blockNodes[L.node];
+            if (B.center < 0 || L.count == 0) continue;
 
             // Calcular distancia query-center
             double dqc = distObj(qId, B.center);
@@ -403,20 +739,16 @@ public:
             uint64_t minKey = composeKey(B.blockValue, minDK);
             uint64_t maxKey = composeKey(B.blockValue, maxDK);
 
-            // Búsqueda por rango en B+-tree
-            auto itLow = btreeIndex.lower_bound(minKey);
-            auto itHigh = btreeIndex.upper_bound(maxKey);
-            
-            pageReads += pagesPerNode;
-
-            for (auto it = itLow; it != itHigh; ++it) {
-                int candidateId = it->second;
-                double d = distObj(qId, candidateId);
+            // Búsqueda por rango en B+-tree: lectura contigua del RAF
+            readRAFRange(minKey, maxKey, rafBuf);
+            for (const RAFEntry& e : rafBuf) {
+                double d = distObj(qId, e.id);
                 if (d <= R) {
-                    out.push_back(candidateId);
+                    out.push_back(e.id);
                 }
             }
         }
+        pageReads += (long long)pagesVisited.size();
 
         auto t1 = clock::now();
         queryTime += std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
@@ -503,6 +835,8 @@ private:
 private:
     // Encuentra k candidatos más cercanos según keys (sin calcular distancias reales)
     void findKCandidatesByKeys(int qId, int k, std::vector<std::pair<uint64_t, int>>& candidates) const {
+        pagesVisited.clear();
+
         // Heurística: encontrar la hoja donde probablemente está q
         std::vector<int> nearLeaves;
         traverseBlockTree(0, qId, 0.0, nearLeaves);
@@ -521,19 +855,8 @@ private:
             if (leafIdx < 0 || leafIdx >= (int)leaves.size()) continue;
             
             const LeafInfo& L = leaves[leafIdx];
-            
-            // Encontrar el BlockNode correspondiente
-            int blockNodeIdx = -1;
-            for (size_t i = 0; i < blockNodes.size(); i++) {
-                if (blockNodes[i].isLeaf && blockNodes[i].leafIdx == leafIdx) {
-                    blockNodeIdx = i;
-                    break;
-                }
-            }
-            
-            if (blockNodeIdx < 0 || blockNodes[blockNodeIdx].center < 0) continue;
-            
-            const BlockNode& B = blockNodes[blockNodeIdx];
+            const BlockNode& B = blockNodes[L.node];
+            if (B.center < 0) continue;
 
             double dqc = distObj(qId, B.center);
             uint32_t dk = normalizeDistance(dqc, B.maxDist);
@@ -542,7 +865,10 @@ private:
             queryKeys.emplace_back(qkey, 0);
         }
 
-        if (queryKeys.empty()) return;
+        if (queryKeys.empty() || rafCount == 0) {
+            pageReads += (long long)pagesVisited.size();
+            return;
+        }
 
         // Buscar en B+-tree los k entries más cercanos a las query keys
         std::set<int> seenIds;
@@ -550,34 +876,30 @@ private:
         for (const auto& [qkey, _] : queryKeys) {
             if ((int)candidates.size() >= k * 3) break;
             
-            auto it = btreeIndex.lower_bound(qkey);
-            if (it == btreeIndex.end() && !btreeIndex.empty()) {
-                it = std::prev(btreeIndex.end());
-            }
-            
-            // Añadir elemento inicial si existe
-            if (it != btreeIndex.end() && seenIds.insert(it->second).second) {
-                candidates.emplace_back(it->first, it->second);
-            }
-            
+            int64_t pos = std::min<int64_t>(lowerBoundPos(qkey), rafCount - 1);
+
+            // k entradas hacia adelante y k hacia atrás: un tramo contiguo del RAF
+            int64_t lo = std::max<int64_t>(0, pos - k);
+            int64_t hi = std::min<int64_t>(rafCount, pos + k);
+            readRAFEntries(lo, hi - lo, rafBuf);
+
             // Expandir hacia adelante
-            auto itForward = it;
-            for (int i = 0; i < k && itForward != btreeIndex.end(); i++) {
-                if (seenIds.insert(itForward->second).second) {
-                    candidates.emplace_back(itForward->first, itForward->second);
+            for (int64_t i = pos; i < hi; i++) {
+                const RAFEntry& e = rafBuf[i - lo];
+                if (seenIds.insert(e.id).second) {
+                    candidates.emplace_back(e.key, e.id);
                 }
-                ++itForward;
             }
             
             // Expandir hacia atrás
-            auto itBackward = it;
-            for (int i = 0; i < k && itBackward != btreeIndex.begin(); i++) {
-                --itBackward;
-                if (seenIds.insert(itBackward->second).second) {
-                    candidates.emplace_back(itBackward->first, itBackward->second);
+            for (int64_t i = pos - 1; i >= lo; i--) {
+                const RAFEntry& e = rafBuf[i - lo];
+                if (seenIds.insert(e.id).second) {
+                    candidates.emplace_back(e.key, e.id);
                 }
             }
         }
+        pageReads += (long long)pagesVisited.size();
     }
 };
 
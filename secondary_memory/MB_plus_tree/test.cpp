@@ -1,4 +1,5 @@
 #include "mbpt.hpp"
+#include "../buffer_pool.hpp"
 #include "../../objectdb.hpp"
 #include "../../datasets/paths.hpp"
 
@@ -20,6 +21,10 @@ static const vector<string> DATASETS = {"LA"};
 // Parámetros por defecto según el survey (puedes ajustar rho si quieres afinar)
 static constexpr double MBPT_RHO = 0.1;
 
+// Buffer pool compartido: presupuesto en páginas de 4KB (0 = sin caché)
+static const size_t BUFFER_POOL_PAGES = 1024;
+static const BufferPool::Policy BUFFER_POOL_POLICY = BufferPool::Policy::LRU;
+
 int main(int argc, char** argv) {
     srand(12345);
 
@@ -82,6 +87,10 @@ int main(int argc, char** argv) {
         // Construir MB+-tree (memoria secundaria)
         cerr << "\n[BUILD] Construyendo MB+-tree con rho=" << MBPT_RHO << "...\n";
 
+        // caché caliente a lo largo de todas las consultas del dataset
+        // (declarado antes del índice: debe sobrevivirlo)
+        BufferPool pool(BUFFER_POOL_PAGES, 4096, BUFFER_POOL_POLICY);
+
         MBPT_Disk mbpt(db.get(), MBPT_RHO);
 
         auto t0 = chrono::high_resolution_clock::now();
@@ -92,6 +101,8 @@ int main(int argc, char** argv) {
 
         cerr << "[BUILD] Tiempo: " << buildTime << " ms\n";
 
+        mbpt.attachBufferPool(&pool);
+
         // Archivo JSON de salida
         string jsonOut = "results/results_MBPT_" + dataset + ".json";
         ofstream J(jsonOut);
@@ -114,6 +125,7 @@ int main(int argc, char** argv) {
             long long totalD = 0;
             long long totalT = 0;
             long long totalPages = 0;
+            pool.reset_stats();
 
             cerr << "  sel=" << sel << " (R=" << R << ")... " << flush;
 
@@ -153,6 +165,10 @@ int main(int argc, char** argv) {
               << "\"compdists\":" << avgD << ","
               << "\"time_ms\":" << avgTms << ","
               << "\"pages\":" << avgPA << ","
+              << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+              << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+              << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+              << "\"hit_rate\":" << pool.get_hitRate() << ","
               << "\"n_queries\":" << queries.size() << ","
               << "\"run_id\":1"
               << "}";
@@ -170,6 +186,7 @@ int main(int argc, char** argv) {
             long long totalD = 0;
             long long totalT = 0;
             long long totalPages = 0;
+            pool.reset_stats();
 
             cerr << "  k=" << k << "... " << flush;
 
@@ -209,6 +226,10 @@ int main(int argc, char** argv) {
               << "\"compdists\":" << avgD << ","
               << "\"time_ms\":" << avgTms << ","
               << "\"pages\":" << avgPA << ","
+              << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+              << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+              << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+              << "\"hit_rate\":" << pool.get_hitRate() << ","
               << "\"n_queries\":" << queries.size() << ","
               << "\"run_id\":1"
               << "}";
@@ -1,7 +1,10 @@
 #pragma once
 #include "../../objectdb.hpp"
+#include "../buffer_pool.hpp"
 #include <bits/stdc++.h>
 #include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -14,10 +17,29 @@ class RAF {
     string filename;
     unordered_map<int, streampos> offsets;
 
+    // Lecturas vía buffer pool compartido (opcional)
+    BufferPool* pool = nullptr;
+    int fd = -1;
+
+    void closeFd() {
+        if (fd < 0) return;
+        if (pool) pool->invalidate(fd);
+        ::close(fd);
+        fd = -1;
+    }
+
 public:
     RAF(const string& fname) : filename(fname) {}
+    ~RAF() { closeFd(); }
+
+    // El pool debe vivir más que el RAF
+    void attachBufferPool(BufferPool* p) {
+        closeFd();
+        pool = p;
+    }
 
     void clear() {
+        closeFd();
         offsets.clear();
         ofstream ofs(filename, ios::binary | ios::trunc);
         ofs.close();
@@ -25,6 +47,7 @@ public:
 
     // Escribe un registro para objId y retorna la posición en el archivo
     streampos append(int objId, const vector<double>& data) {
+        closeFd();  // el archivo cambia: descartar páginas cacheadas
         ofstream ofs(filename, ios::binary | ios::app);
         streampos pos = ofs.tellp();
 
@@ -47,6 +70,24 @@ public:
             throw runtime_error("RAF: object not found");
         }
 
+        if (pool) {
+            if (fd < 0) {
+                fd = ::open(filename.c_str(), O_RDONLY);
+                if (fd < 0)
+                    throw runtime_error("RAF: cannot open file for read");
+            }
+            int64_t off = (int64_t)it->second;
+            int id;
+            uint64_t sz;
+            pool->read(fd, off, sizeof(id), &id);
+            pool->read(fd, off + (int64_t)sizeof(id), sizeof(sz), &sz);
+            vector<double> data(sz);
+            if (sz > 0)
+                pool->read(fd, off + (int64_t)(sizeof(id) + sizeof(sz)),
+                           sz * sizeof(double), data.data());
+            return data;
+        }
+
         ifstream ifs(filename, ios::binary);
         if (!ifs.is_open()) {
             throw runtime_error("RAF: cannot open file for read");
@@ -622,4 +663,7 @@ public:
 
     long long get_compDist() const { return compDist; }
     long long get_pageReads() const { return pageReads; }
+
+    // Lecturas del RAF a través de un buffer pool compartido (nullptr = ifstream)
+    void attachBufferPool(BufferPool* pool) { raf.attachBufferPool(pool); }
 };
@@ -1,6 +1,7 @@
 #include <bits/stdc++.h>
 #include <filesystem>
 #include "omnirtree.hpp"
+#include "../buffer_pool.hpp"
 #include "../../objectdb.hpp"
 #include "../../datasets/paths.hpp"
 
@@ -15,6 +16,10 @@ static const vector<int> K_VALUES = {5, 10, 20, 50, 100};
 // static const vector<string> DATASETS = {"LA", "Words", "Color", "Synthetic"};
 static const vector<string> DATASETS = {"LA"};
 
+// Buffer pool compartido: presupuesto en páginas de 4KB (0 = sin caché)
+static const size_t BUFFER_POOL_PAGES = 1024;
+static const BufferPool::Policy BUFFER_POOL_POLICY = BufferPool::Policy::LRU;
+
 int main(int argc, char** argv) {
     srand(12345);
 
@@ -89,6 +94,10 @@ int main(int argc, char** argv) {
         string rafFile = "omni_indexes/" + dataset + "_l" +
                          to_string(num_pivots) + "_raf.bin";
 
+        // caché caliente a lo largo de todas las consultas del dataset
+        // (declarado antes del índice: debe sobrevivirlo)
+        BufferPool pool(BUFFER_POOL_PAGES, 4096, BUFFER_POOL_POLICY);
+
         // Crear OmniR-tree
         OmniRTree omni(rafFile, db.get(), num_pivots, rtree_node_cap);
 
@@ -113,6 +122,8 @@ int main(int argc, char** argv) {
 
         cerr << "[BUILD] Completado en " << buildTimeMs << " ms\n";
 
+        omni.attachBufferPool(&pool);
+
         // MRQ - Variar selectividad (escenario de memoria secundaria)
         cerr << "\n[MRQ] Ejecutando queries de rango (l="
              << num_pivots << ")...\n";
@@ -128,6 +139,7 @@ int main(int argc, char** argv) {
             long long totalD = 0;       // distancias totales (pivotes + verificación)
             long long totalT = 0;       // tiempo total (µs)
             long long totalPages = 0;   // page reads promedio
+            pool.reset_stats();
 
             cerr << "  sel=" << sel << " (R=" << R << ")... " << flush;
 
@@ -167,6 +179,10 @@ int main(int argc, char** argv) {
               << "\"compdists\":" << avgD << ","
               << "\"time_ms\":" << avgTms << ","
               << "\"pages\":" << avgPA << ","
+              << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+              << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+              << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+              << "\"hit_rate\":" << pool.get_hitRate() << ","
               << "\"n_queries\":" << queries.size() << ","
               << "\"run_id\":1"
               << "}";
@@ -183,6 +199,7 @@ int main(int argc, char** argv) {
             long long totalD = 0;
             long long totalT = 0;
             long long totalPages = 0;
+            pool.reset_stats();
 
             cerr << "  k=" << k << "... " << flush;
 
@@ -222,6 +239,10 @@ int main(int argc, char** argv) {
               << "\"compdists\":" << avgD << ","
               << "\"time_ms\":" << avgTms << ","
               << "\"pages\":" << avgPA << ","
+              << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+              << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+              << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+              << "\"hit_rate\":" << pool.get_hitRate() << ","
               << "\"n_queries\":" << queries.size() << ","
               << "\"run_id\":1"
               << "}";
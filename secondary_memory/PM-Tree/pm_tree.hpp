@@ -2,6 +2,7 @@
 #define PM_TREE_HPP
 
 #include "../../objectdb.hpp"
+#include "../M-Tree/mtree.hpp"
 
 #include <vector>
 #include <queue>
@@ -12,9 +13,19 @@
 #include <stdexcept>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <map>
 #include <iostream>
 
+#include <sys/stat.h>
+
+// Prueba de anillos vectorizada: se compila con target("avx") y se elige
+// en tiempo de ejecución, así que no hace falta -mavx ni -march=native.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PMTREE_HAVE_AVX 1
+#endif
+
 class PMTree {
 public:
     // Metrics (queries)
@@ -56,6 +67,7 @@ public:
     }
 
     int get_num_pivots() const { return nPivots; }
+    const std::vector<int>& get_pivots() const { return pivots; }
 
     void buildFromMTree(const std::string& basePath) {
         nodes.clear();
@@ -67,85 +79,25 @@ public:
         }
 
         std::string indexPath = basePath + ".mtree_index";
-        FILE* fp = std::fopen(indexPath.c_str(), "rb");
-        if (!fp) {
-            std::cerr << "[PMTree] buildFromMTree: cannot open " << indexPath << "\n";
-            return;
-        }
+        sourceId = mtreeSourceId(indexPath);
 
+        // Lectura del índice M-tree (formato paginado o antiguo)
         int64_t rootOffset = -1;
-        if (std::fread(&rootOffset, sizeof(int64_t), 1, fp) != 1) {
-            std::cerr << "[PMTree] buildFromMTree: corrupted file (no rootOffset)\n";
-            std::fclose(fp);
+        std::vector<MTree_Disk::RawNode> rawNodes;
+        if (!MTree_Disk::loadAllNodes(indexPath, rootOffset, rawNodes)) {
+            std::cerr << "[PMTree] buildFromMTree: cannot read " << indexPath << "\n";
             return;
         }
 
-        struct RawEntry {
-            int32_t objId;
-            double  radius;
-            double  parentDist;
-            int64_t childOffset;
-        };
-
-        struct RawNode {
-            bool isLeaf;
-            int32_t count;
-            int64_t offset;
-            std::vector<RawEntry> entries;
-        };
-
-        std::vector<RawNode> rawNodes;
-        std::map<int64_t,int> offsetToIndex;
-
-        while (true) {
-            int64_t pos = std::ftell(fp);
-            bool isLeaf;
-            int32_t count;
-
-            size_t r1 = std::fread(&isLeaf, sizeof(bool), 1, fp);
-            if (r1 != 1) {
-                if (!std::feof(fp)) {
-                    std::cerr << "[PMTree] buildFromMTree: fread(isLeaf) failed\n";
-                }
-                break;
-            }
-            if (std::fread(&count, sizeof(int32_t), 1, fp) != 1) {
-                std::cerr << "[PMTree] buildFromMTree: fread(count) failed\n";
-                break;
-            }
-
-            RawNode node;
-            node.isLeaf = isLeaf;
-            node.count  = count;
-            node.offset = pos;
-            node.entries.resize(count);
-
-            for (int i = 0; i < count; ++i) {
-                RawEntry e;
-                if (std::fread(&e.objId,      sizeof(int32_t), 1, fp) != 1 ||
-                    std::fread(&e.radius,     sizeof(double),  1, fp) != 1 ||
-                    std::fread(&e.parentDist, sizeof(double),  1, fp) != 1 ||
-                    std::fread(&e.childOffset,sizeof(int64_t), 1, fp) != 1) {
-                    std::cerr << "[PMTree] buildFromMTree: fread(entry) failed\n";
-                    rawNodes.clear();
-                    std::fclose(fp);
-                    return;
-                }
-                node.entries[i] = e;
-            }
-
-            int idx = (int)rawNodes.size();
-            rawNodes.push_back(std::move(node));
-            offsetToIndex[pos] = idx;
-        }
-
-        std::fclose(fp);
-
         if (rawNodes.empty()) {
             std::cerr << "[PMTree] buildFromMTree: no nodes found in index\n";
             return;
         }
 
+        std::map<int64_t,int> offsetToIndex;
+        for (size_t i = 0; i < rawNodes.size(); ++i)
+            offsetToIndex[rawNodes[i].offset] = (int)i;
+
         auto itRoot = offsetToIndex.find(rootOffset);
         if (itRoot == offsetToIndex.end()) {
             std::cerr << "[PMTree] buildFromMTree: rootOffset not found in nodes\n";
@@ -157,9 +109,9 @@ public:
         nodes.resize(rawNodes.size());
         for (size_t i = 0; i < rawNodes.size(); ++i) {
             nodes[i].isLeaf = rawNodes[i].isLeaf;
-            nodes[i].entries.resize(rawNodes[i].count);
-            for (int j = 0; j < rawNodes[i].count; ++j) {
-                const RawEntry& re = rawNodes[i].entries[j];
+            nodes[i].entries.resize(rawNodes[i].entries.size());
+            for (size_t j = 0; j < rawNodes[i].entries.size(); ++j) {
+                const MTree_Disk::Entry& re = rawNodes[i].entries[j];
                 Entry& e = nodes[i].entries[j];
                 e.objId      = re.objId;
                 e.radius     = re.radius;
@@ -194,6 +146,158 @@ public:
         recomputePivotData();
     }
 
+    // ---- Índice propio (.pmtree_index) ----
+    // Cabecera + pivotes + nodos en orden. Cada entrada guarda a continuación
+    // sus anillos [min, max] por pivote en float, redondeados hacia fuera
+    // (min hacia abajo, max hacia arriba): las cotas siguen siendo conservadoras.
+    // load() es una única lectura secuencial y no calcula ninguna distancia.
+    // La cabecera guarda un identificador del .mtree_index de origen
+    // (mtreeSourceId): con mtreeBase, load() rechaza un índice construido
+    // a partir de otro M-tree.
+    bool save(const std::string& basePath) const {
+        if (nodes.empty() || rootIndex < 0 || (int)pivots.size() != nPivots) {
+            std::cerr << "[PMTree] save: tree or pivots not ready\n";
+            return false;
+        }
+
+        std::string path = basePath + ".pmtree_index";
+        FILE* fp = std::fopen(path.c_str(), "wb");
+        if (!fp) {
+            std::cerr << "[PMTree] save: cannot create " << path << "\n";
+            return false;
+        }
+
+        std::vector<char> buf;
+        auto put = [&](const void* p, size_t len) {
+            const char* c = static_cast<const char*>(p);
+            buf.insert(buf.end(), c, c + len);
+        };
+
+        FileHeader h;
+        std::memset(&h, 0, sizeof(FileHeader));
+        std::memcpy(h.magic, "PMTREE1", 8);
+        h.version   = FILE_VERSION;
+        h.nPivots   = nPivots;
+        h.nObjects  = n;
+        h.nodeCount = (int32_t)nodes.size();
+        h.rootIndex = rootIndex;
+        h.sourceId  = sourceId;
+        put(&h, sizeof(FileHeader));
+        put(pivots.data(), pivots.size() * sizeof(int32_t));
+
+        std::vector<float> ring(2 * (size_t)nPivots);
+        for (const Node& node : nodes) {
+            NodeRec nr;
+            std::memset(&nr, 0, sizeof(NodeRec));
+            nr.isLeaf = node.isLeaf ? 1 : 0;
+            nr.count  = (int32_t)node.entries.size();
+            put(&nr, sizeof(NodeRec));
+
+            for (size_t i = 0; i < node.entries.size(); ++i) {
+                const Entry& e = node.entries[i];
+                EntryRec er{e.objId, e.child, e.radius, e.parentDist};
+                put(&er, sizeof(EntryRec));
+                for (int j = 0; j < nPivots; ++j) {
+                    ring[j]           = node.lo(j, i);
+                    ring[nPivots + j] = node.hi(j, i);
+                }
+                put(ring.data(), ring.size() * sizeof(float));
+            }
+        }
+
+        bool ok = std::fwrite(buf.data(), 1, buf.size(), fp) == buf.size();
+        ok = (std::fclose(fp) == 0) && ok;
+        if (!ok) std::cerr << "[PMTree] save: write failed for " << path << "\n";
+        return ok;
+    }
+
+    bool load(const std::string& basePath, const std::string& mtreeBase = "") {
+        std::string path = basePath + ".pmtree_index";
+        FILE* fp = std::fopen(path.c_str(), "rb");
+        if (!fp) return false;
+
+        std::vector<char> buf;
+        if (std::fseek(fp, 0, SEEK_END) == 0) {
+            long size = std::ftell(fp);
+            if (size > 0) {
+                buf.resize((size_t)size);
+                std::rewind(fp);
+                if (std::fread(buf.data(), 1, buf.size(), fp) != buf.size())
+                    buf.clear();
+            }
+        }
+        std::fclose(fp);
+
+        size_t pos = 0;
+        auto get = [&](void* p, size_t len) {
+            if (pos + len > buf.size()) return false;
+            std::memcpy(p, buf.data() + pos, len);
+            pos += len;
+            return true;
+        };
+
+        FileHeader h;
+        if (!get(&h, sizeof(FileHeader)) ||
+            std::memcmp(h.magic, "PMTREE1", 8) != 0 || h.version != FILE_VERSION) {
+            std::cerr << "[PMTree] load: invalid file " << path << "\n";
+            return false;
+        }
+        if (!db || h.nObjects != n || h.nPivots <= 0 || h.nodeCount <= 0 ||
+            h.rootIndex < 0 || h.rootIndex >= h.nodeCount) {
+            std::cerr << "[PMTree] load: " << path << " does not match the database\n";
+            return false;
+        }
+        if (!mtreeBase.empty() && h.sourceId != mtreeSourceId(mtreeBase + ".mtree_index")) {
+            std::cerr << "[PMTree] load: " << path << " was built from another "
+                      << mtreeBase << ".mtree_index\n";
+            return false;
+        }
+
+        std::vector<int> piv(h.nPivots);
+        std::vector<Node> loaded(h.nodeCount);
+        std::vector<float> ring(2 * (size_t)h.nPivots);
+        bool ok = get(piv.data(), piv.size() * sizeof(int32_t));
+        for (int i = 0; ok && i < h.nodeCount; ++i) {
+            NodeRec nr;
+            ok = get(&nr, sizeof(NodeRec)) && nr.count >= 0;
+            if (!ok) break;
+            Node& node = loaded[i];
+            node.isLeaf = nr.isLeaf != 0;
+            node.entries.resize(nr.count);
+            node.resetRings(h.nPivots);
+            for (int k = 0; k < nr.count; ++k) {
+                Entry& e = node.entries[k];
+                EntryRec er;
+                ok = get(&er, sizeof(EntryRec)) && get(ring.data(), ring.size() * sizeof(float));
+                if (!ok) break;
+                e.objId      = er.objId;
+                e.child      = er.child;
+                e.radius     = er.radius;
+                e.parentDist = er.parentDist;
+                for (int j = 0; j < h.nPivots; ++j) {
+                    node.lo(j, k) = ring[j];
+                    node.hi(j, k) = ring[h.nPivots + j];
+                }
+            }
+        }
+        if (!ok) {
+            std::cerr << "[PMTree] load: truncated file " << path << "\n";
+            return false;
+        }
+
+        nPivots   = h.nPivots;
+        pivots    = std::move(piv);
+        nodes     = std::move(loaded);
+        rootIndex = h.rootIndex;
+        sourceId  = h.sourceId;
+        distMatrix.clear();
+        compDistBuild = 0;
+
+        std::cerr << "[PMTree] Loaded " << nodes.size()
+                  << " nodes from " << path << "\n";
+        return true;
+    }
+
     // Metrics API
     void clear_counters() const {
         compDistQuery = 0;
@@ -227,20 +331,25 @@ public:
             compDistQuery++;
         }
 
+        // Anillo de la consulta por pivote: [d(q,p)-r, d(q,p)+r]
+        std::vector<float> qLo, qHi;
+        queryRings(qPiv, radius, qLo, qHi);
+
         // 2. DFS over the tree
         std::function<void(int)> dfs = [&](int nodeIdx) {
             const Node& node = nodes[nodeIdx];
             pageReads++;
 
+            // Pivot-based filter over every entry of the node at once
+            std::vector<int> survivors;
+            ringSurvivors(node, qLo.data(), qHi.data(), survivors);
+
             if (node.isLeaf) {
-                // Leaf: check each object using pivot LB + exact distance.
-                for (const Entry& e : node.entries) {
-                    int objId = e.objId;
+                // Leaf: exact distance for the objects that passed the rings.
+                for (int i : survivors) {
+                    int objId = node.entries[i].objId;
                     if (objId < 0 || objId >= n) continue;
 
-                    double lbPiv = lowerBoundObject(qPiv, objId);
-                    if (lbPiv > radius) continue;
-
                     double d = db->distance(queryId, objId);
                     compDistQuery++;
                     if (d <= radius) {
@@ -248,15 +357,12 @@ public:
                     }
                 }
             } else {
-                // Internal node: check each entry (subtree).
-                for (const Entry& e : node.entries) {
+                // Internal node: check each surviving entry (subtree).
+                for (int i : survivors) {
+                    const Entry& e = node.entries[i];
                     if (e.child < 0) continue;
 
-                    // 1) Pivot-based lower bound for the subtree
-                    double lbPiv = lowerBoundEntry(qPiv, e);
-                    if (lbPiv > radius) continue;
-
-                    // 2) Ball-based lower bound (Lemma 4.2)
+                    // Ball-based lower bound (Lemma 4.2)
                     double dQC = db->distance(queryId, e.objId);
                     compDistQuery++;
                     double lbBall = std::max(dQC - e.radius, 0.0);
@@ -318,6 +424,9 @@ public:
         // Initial bound for root: 0
         pq.push(NodeCand{0.0, rootIndex});
 
+        std::vector<float> qLo, qHi;
+        std::vector<int> survivors;
+
         while (!pq.empty()) {
             NodeCand cur = pq.top();
             pq.pop();
@@ -327,14 +436,17 @@ public:
             const Node& node = nodes[cur.nodeIdx];
             pageReads++;
 
+            // Ring filter with the current k-th distance as radius
+            queryRings(qPiv, tau, qLo, qHi);
+            survivors.clear();
+            ringSurvivors(node, qLo.data(), qHi.data(), survivors);
+
             if (node.isLeaf) {
-                // Check each object in this leaf
-                for (const Entry& e : node.entries) {
-                    int objId = e.objId;
+                // Check each surviving object in this leaf
+                for (int i : survivors) {
+                    int objId = node.entries[i].objId;
                     if (objId < 0 || objId >= n) continue;
-
-                    double lbPiv = lowerBoundObject(qPiv, objId);
-                    if (lbPiv >= tau) continue;
+                    if (ringLowerBound(node, i, qPiv) >= tau) continue;
 
                     double d = db->distance(queryId, objId);
                     compDistQuery++;
@@ -351,12 +463,13 @@ public:
                     }
                 }
             } else {
-                // Expand internal node
-                for (const Entry& e : node.entries) {
+                // Expand surviving entries of the internal node
+                for (int i : survivors) {
+                    const Entry& e = node.entries[i];
                     if (e.child < 0) continue;
 
                     // 1) Pivot-based lower bound for subtree
-                    double lbPiv = lowerBoundEntry(qPiv, e);
+                    double lbPiv = ringLowerBound(node, i, qPiv);
                     if (lbPiv >= tau) continue;
 
                     // 2) Ball-based lower bound (Lemma 4.2)
@@ -391,7 +504,76 @@ private:
     int nPivots  = 0;  // #pivots
 
     std::vector<int> pivots;                      // pivot IDs
-    std::vector<std::vector<double>> distMatrix;  // [obj][pivot] = d(obj,pivot)
+    std::vector<std::vector<double>> distMatrix;  // [obj][pivot], solo durante recomputePivotData
+
+    // ---- Formato de .pmtree_index ----
+    static constexpr uint32_t FILE_VERSION = 2;
+
+    struct FileHeader {
+        char     magic[8];   // "PMTREE1"
+        uint32_t version;
+        int32_t  nPivots;
+        int32_t  nObjects;
+        int32_t  nodeCount;
+        int32_t  rootIndex;
+        int32_t  reserved;
+        uint64_t sourceId;   // mtreeSourceId del .mtree_index de origen
+    };
+
+    uint64_t sourceId = 0;
+
+    // Identificador de un .mtree_index: tamaño, fecha de modificación y
+    // FNV-1a de su primera página (cabecera: página, capacidad, raíz y nº
+    // de nodos). Reconstruir el M-tree lo cambia; 0 si no se puede leer.
+    static uint64_t mtreeSourceId(const std::string& indexPath) {
+        struct stat st;
+        if (::stat(indexPath.c_str(), &st) != 0) return 0;
+        FILE* fp = std::fopen(indexPath.c_str(), "rb");
+        if (!fp) return 0;
+        std::vector<unsigned char> head(4096);
+        head.resize(std::fread(head.data(), 1, head.size(), fp));
+        std::fclose(fp);
+
+        uint64_t hsh = 1469598103934665603ull;
+        auto mix = [&](const void* p, size_t len) {
+            const unsigned char* c = static_cast<const unsigned char*>(p);
+            for (size_t i = 0; i < len; ++i) { hsh ^= c[i]; hsh *= 1099511628211ull; }
+        };
+        int64_t size  = (int64_t)st.st_size;
+        int64_t mtime = (int64_t)st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+        mix(&size, sizeof(size));
+        mix(&mtime, sizeof(mtime));
+        mix(head.data(), head.size());
+        return hsh ? hsh : 1;
+    }
+
+#pragma pack(push, 1)
+    struct NodeRec {
+        uint8_t isLeaf;
+        uint8_t pad[3];
+        int32_t count;
+    };
+
+    // seguida de nPivots floats min y nPivots floats max
+    struct EntryRec {
+        int32_t objId;
+        int32_t child;       // índice del nodo hijo, -1 en hojas
+        double  radius;
+        double  parentDist;
+    };
+#pragma pack(pop)
+
+    static float roundDown(double x) {
+        float f = (float)x;
+        if ((double)f > x) f = std::nextafter(f, -std::numeric_limits<float>::infinity());
+        return f;
+    }
+
+    static float roundUp(double x) {
+        float f = (float)x;
+        if ((double)f < x) f = std::nextafter(f, std::numeric_limits<float>::infinity());
+        return f;
+    }
 
     struct Entry {
         int    objId      = -1;
@@ -399,14 +581,32 @@ private:
         double parentDist = 0.0;
         int    child      = -1;
         int64_t childOffset = -1; // only used during buildFromMTree
-
-        std::vector<double> minPiv; // per-pivot min distance in subtree
-        std::vector<double> maxPiv; // per-pivot max distance in subtree
     };
 
+    // Los anillos [min, max] por pivote de todas las entradas del nodo se
+    // guardan en SoA: ringLo[j*stride + i] es el mínimo del pivote j en la
+    // entrada i (hoja: d(obj, pivote j)). Van en float redondeado hacia fuera,
+    // y stride es el nº de entradas redondeado a múltiplo de 8 (un registro
+    // AVX); el relleno nunca se reporta como superviviente.
     struct Node {
         bool isLeaf = false;
         std::vector<Entry> entries;
+
+        int stride = 0;
+        std::vector<float> ringLo;
+        std::vector<float> ringHi;
+
+        float& lo(int j, size_t i)       { return ringLo[(size_t)j * stride + i]; }
+        float& hi(int j, size_t i)       { return ringHi[(size_t)j * stride + i]; }
+        float  lo(int j, size_t i) const { return ringLo[(size_t)j * stride + i]; }
+        float  hi(int j, size_t i) const { return ringHi[(size_t)j * stride + i]; }
+
+        // Anillos sin información: [0, +inf] no poda nada
+        void resetRings(int p) {
+            stride = ((int)entries.size() + 7) & ~7;
+            ringLo.assign((size_t)p * stride, 0.0f);
+            ringHi.assign((size_t)p * stride, std::numeric_limits<float>::infinity());
+        }
     };
 
     std::vector<Node> nodes;
@@ -433,6 +633,10 @@ void recomputePivotData() {
     // 2) Compute min/max per entry (bottom-up)
     std::vector<bool> visited(nodes.size(), false);
     computeEntryBounds(rootIndex, visited);
+
+    // las hojas ya guardan d(obj, pivot) en sus anillos: la tabla sobra
+    distMatrix.clear();
+    distMatrix.shrink_to_fit();
 }
 
     void computeEntryBounds(int nodeIdx, std::vector<bool>& visited) {
@@ -441,16 +645,15 @@ void recomputePivotData() {
         visited[nodeIdx] = true;
 
         Node& node = nodes[nodeIdx];
+        node.resetRings(nPivots);
 
         if (node.isLeaf) {
-            for (Entry& e : node.entries) {
-                int objId = e.objId;
-                e.minPiv.resize(nPivots);
-                e.maxPiv.resize(nPivots);
+            for (size_t i = 0; i < node.entries.size(); ++i) {
+                int objId = node.entries[i].objId;
                 for (int j = 0; j < nPivots; ++j) {
                     double v = distMatrix[objId][j];
-                    e.minPiv[j] = v;
-                    e.maxPiv[j] = v;
+                    node.lo(j, i) = roundDown(v);
+                    node.hi(j, i) = roundUp(v);
                 }
             }
         } else {
@@ -460,52 +663,104 @@ void recomputePivotData() {
                     computeEntryBounds(e.child, visited);
                 }
             }
-            for (Entry& e : node.entries) {
-                if (e.child < 0) {
-                    e.minPiv.assign(nPivots, std::numeric_limits<double>::infinity());
-                    e.maxPiv.assign(nPivots, 0.0);
-                    continue;
-                }
-                Node& childNode = nodes[e.child];
-                e.minPiv.assign(nPivots, std::numeric_limits<double>::infinity());
-                e.maxPiv.assign(nPivots, 0.0);
-
-                for (Entry& ce : childNode.entries) {
-                    if (ce.minPiv.empty()) continue;
+            for (size_t i = 0; i < node.entries.size(); ++i) {
+                const Entry& e = node.entries[i];
+                if (e.child < 0) continue;
+                const Node& childNode = nodes[e.child];
+
+                // union of the children's rings (entries without a subtree
+                // carry no information and are left out)
+                bool any = false;
+                for (size_t c = 0; c < childNode.entries.size(); ++c) {
+                    if (!childNode.isLeaf && childNode.entries[c].child < 0) continue;
                     for (int j = 0; j < nPivots; ++j) {
-                        e.minPiv[j] = std::min(e.minPiv[j], ce.minPiv[j]);
-                        e.maxPiv[j] = std::max(e.maxPiv[j], ce.maxPiv[j]);
+                        float a = childNode.lo(j, c);
+                        float b = childNode.hi(j, c);
+                        node.lo(j, i) = any ? std::min(node.lo(j, i), a) : a;
+                        node.hi(j, i) = any ? std::max(node.hi(j, i), b) : b;
                     }
+                    any = true;
                 }
             }
         }
     }
 
-    double lowerBoundEntry(const std::vector<double>& qPiv, const Entry& e) const {
-        double lb = 0.0;
+    // Anillo de la consulta para el radio r, redondeado hacia fuera para que
+    // la comparación en float no descarte nada que la exacta aceptaría
+    void queryRings(const std::vector<double>& qPiv, double r,
+                    std::vector<float>& qLo, std::vector<float>& qHi) const {
+        qLo.resize(nPivots);
+        qHi.resize(nPivots);
         for (int j = 0; j < nPivots; ++j) {
-            double x = qPiv[j];
-            double a = e.minPiv[j];
-            double b = e.maxPiv[j];
-            if (a == std::numeric_limits<double>::infinity() && b == 0.0) {
-                // empty info, skip
-                continue;
+            qLo[j] = roundDown(qPiv[j] - r);
+            qHi[j] = roundUp(qPiv[j] + r);
+        }
+    }
+
+    // Entradas i del nodo cuyo anillo corta al de la consulta en todos los
+    // pivotes: lo[j][i] <= qHi[j] y hi[j][i] >= qLo[j]
+    void ringSurvivors(const Node& node, const float* qLo, const float* qHi,
+                       std::vector<int>& out) const {
+#ifdef PMTREE_HAVE_AVX
+        static const bool hasAVX = __builtin_cpu_supports("avx");
+        if (hasAVX) {
+            ringSurvivorsAVX(node, nPivots, qLo, qHi, out);
+            return;
+        }
+#endif
+        const int count = (int)node.entries.size();
+        for (int i = 0; i < count; ++i) {
+            bool ok = true;
+            for (int j = 0; j < nPivots && ok; ++j)
+                ok = node.lo(j, i) <= qHi[j] && node.hi(j, i) >= qLo[j];
+            if (ok) out.push_back(i);
+        }
+    }
+
+#ifdef PMTREE_HAVE_AVX
+    // 8 entradas por iteración; la máscara se acumula pivote a pivote y el
+    // bloque se abandona en cuanto no queda ninguna entrada viva
+    __attribute__((target("avx")))
+    static void ringSurvivorsAVX(const Node& node, int p, const float* qLo,
+                                 const float* qHi, std::vector<int>& out) {
+        const int count = (int)node.entries.size();
+        const float* loBase = node.ringLo.data();
+        const float* hiBase = node.ringHi.data();
+
+        for (int b = 0; b < count; b += 8) {
+            __m256 alive = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int j = 0; j < p; ++j) {
+                const size_t off = (size_t)j * node.stride + b;
+                __m256 lo = _mm256_loadu_ps(loBase + off);
+                __m256 hi = _mm256_loadu_ps(hiBase + off);
+                __m256 ok = _mm256_and_ps(
+                    _mm256_cmp_ps(lo, _mm256_set1_ps(qHi[j]), _CMP_LE_OQ),
+                    _mm256_cmp_ps(hi, _mm256_set1_ps(qLo[j]), _CMP_GE_OQ));
+                alive = _mm256_and_ps(alive, ok);
+                if (_mm256_testz_ps(alive, alive)) break;
+            }
+
+            unsigned mask = (unsigned)_mm256_movemask_ps(alive);
+            if (count - b < 8) mask &= (1u << (count - b)) - 1;
+            while (mask) {
+                out.push_back(b + __builtin_ctz(mask));
+                mask &= mask - 1;
             }
-            double v = 0.0;
-            if (x < a) v = a - x;
-            else if (x > b) v = x - b;
-            else v = 0.0;
-            if (v > lb) lb = v;
         }
-        return lb;
     }
+#endif
 
-    double lowerBoundObject(const std::vector<double>& qPiv, int objId) const {
+    // Cota inferior por pivotes de la entrada i (para ordenar el kNN)
+    double ringLowerBound(const Node& node, int i, const std::vector<double>& qPiv) const {
         double lb = 0.0;
-        const std::vector<double>& v = distMatrix[objId];
         for (int j = 0; j < nPivots; ++j) {
-            double diff = std::fabs(qPiv[j] - v[j]);
-            if (diff > lb) lb = diff;
+            double x = qPiv[j];
+            double a = node.lo(j, i);
+            double b = node.hi(j, i);
+            double v = 0.0;
+            if (x < a) v = a - x;
+            else if (x > b) v = x - b;
+            if (v > lb) lb = v;
         }
         return lb;
     }
@@ -5,10 +5,6 @@
 
 using namespace std;
 
-<<<<<<< HEAD
-
-=======
->>>>>>> 9afe3324c55fc1654e1186b2a3dbd0d325be8cf1
 // Selectividades para MRQ
 static const vector<double> SELECTIVITIES = {0.02, 0.04, 0.08, 0.16, 0.32};
 
@@ -137,10 +133,17 @@ int main(int argc, char** argv) {
                  << " pivots para " << dataset << "\n";
             cerr << "------------------------------------------\n";
 
-            // Construir PM-tree a partir del índice M-tree en disco
+            // Cargar el índice propio del PM-tree (sin cálculos de distancia);
+            // si no existe, usa otros pivotes o viene de otro M-tree,
+            // construirlo a partir del M-tree en disco y guardarlo para la
+            // próxima ejecución
+            string pmBase = dataset + "_l" + to_string(l);
             PMTree pmt(db.get(), l);
-            pmt.buildFromMTree(dataset);
-            pmt.overridePivots(pivots);    // HFI pivots
+            if (!pmt.load(pmBase, dataset) || pmt.get_pivots() != pivots) {
+                pmt.buildFromMTree(dataset);
+                pmt.overridePivots(pivots);    // HFI pivots
+                pmt.save(pmBase);
+            }
 
             using clock = std::chrono::high_resolution_clock;
 
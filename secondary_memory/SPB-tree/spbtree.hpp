@@ -2,6 +2,9 @@
 #include <bits/stdc++.h>
 #include "../../objectdb.hpp"
 #include "../../datasets/paths.hpp"
+#include "../buffer_pool.hpp"
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -24,6 +27,17 @@ class RAF {
 
     size_t logicalPageFactor;
 
+    // Lecturas vía buffer pool compartido (opcional)
+    BufferPool* pool = nullptr;
+    mutable int fd = -1;
+
+    void closeFd() const {
+        if (fd < 0) return;
+        if (pool) pool->invalidate(fd);
+        ::close(fd);
+        fd = -1;
+    }
+
     void ensureOpenForRW() const {
         if (!file.is_open()) {
             const_cast<RAF*>(this)->file.open(
@@ -48,13 +62,21 @@ public:
     }
 
     ~RAF() {
+        closeFd();
         if (file.is_open()) {
             file.close();
         }
     }
 
+    // El pool debe vivir más que el RAF
+    void attachBufferPool(BufferPool* p) {
+        closeFd();
+        pool = p;
+    }
+
     // Permite reutilizar el mismo RAF al reconstruir el índice
     void resetFile() {
+        closeFd();
         if (file.is_open()) {
             file.close();
         }
@@ -69,6 +91,7 @@ public:
     // Escribe un objeto al final del fichero y devuelve el offset
     streampos append(const DataObject &o) {
         ensureOpenForRW();
+        closeFd();  // el archivo cambia: descartar páginas cacheadas
 
         // Ir al final para append explícito
         file.seekp(0, ios::end);
@@ -100,6 +123,8 @@ public:
         );
         pagesVisited.insert(pageId);
 
+        if (pool) return readPooled(off);
+
         // Posicionarse y leer registro
         file.seekg(it->second);
         if (!file.good()) {
@@ -127,6 +152,24 @@ public:
         return o;
     }
 
+    // Registro leído a través del buffer pool: cabecera (id, len) + payload
+    DataObject readPooled(long long off) const {
+        if (fd < 0) {
+            fd = ::open(filename.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw runtime_error("RAF: cannot open file for pooled read " + filename);
+        }
+        DataObject o;
+        uint64_t len = 0;
+        pool->read(fd, off, sizeof(o.id), &o.id);
+        pool->read(fd, off + (long long)sizeof(o.id), sizeof(len), &len);
+        o.payload.assign(len, 0.0);
+        if (len > 0)
+            pool->read(fd, off + (long long)(sizeof(o.id) + sizeof(len)),
+                       len * sizeof(double), o.payload.data());
+        return o;
+    }
+
     long long get_pageReads() const {
         return static_cast<long long>(pagesVisited.size()) *
                static_cast<long long>(logicalPageFactor);
@@ -733,6 +776,9 @@ public:
     long long get_compDist() const { return pt.get_compDist(); }
     long long get_pageReads() const { return raf.get_pageReads(); }
 
+    // Lecturas del RAF a través de un buffer pool compartido (nullptr = fstream)
+    void attachBufferPool(BufferPool* pool) { raf.attachBufferPool(pool); }
+
     void clear_counters() {
         pt.clear_compDist();
         raf.clear_pageReads();
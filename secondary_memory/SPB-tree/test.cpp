@@ -1,5 +1,6 @@
 #include <bits/stdc++.h>
 #include "spbtree.hpp"
+#include "../buffer_pool.hpp"
 #include "../../objectdb.hpp"
 #include "../../datasets/paths.hpp"
 
@@ -24,6 +25,10 @@ static const vector<string> DATASETS = {"LA"};
 
 static const int NUM_PIVOTS = 5;
 
+// Buffer pool compartido: presupuesto en páginas de 4KB (0 = sin caché)
+static const size_t BUFFER_POOL_PAGES = 1024;
+static const BufferPool::Policy BUFFER_POOL_POLICY = BufferPool::Policy::LRU;
+
 // Parámetros del B+ tree
 static const size_t LEAF_CAPACITY = 128;
 static const size_t FANOUT        = 64;
@@ -155,6 +160,10 @@ int main(int argc, char** argv) {
 
         string rafFile = "spb_indexes/" + dataset + "_raf.bin";
 
+        // caché caliente a lo largo de todas las consultas del dataset
+        // (declarado antes del índice: debe sobrevivirlo)
+        BufferPool pool(BUFFER_POOL_PAGES, 4096, BUFFER_POOL_POLICY);
+
         SPBTree spb(
             rafFile,
             db.get(),
@@ -173,6 +182,8 @@ int main(int argc, char** argv) {
         spb.build(allObjects, hfiPivots);
         cerr << "[BUILD] OK.\n";
 
+        spb.attachBufferPool(&pool);
+
         // MRQ (Range Queries) – RQA (Algorithm 3)
         cerr << "\n[MRQ] Ejecutando selectividades...\n";
 
@@ -185,6 +196,7 @@ int main(int argc, char** argv) {
             long long totalD = 0;   // distancias totales (pivot + verificación)
             long long totalT = 0;   // tiempo
             long long totalP = 0;   // page reads lógicos en RAF
+            pool.reset_stats();
 
             for (int q : queries) {
                 spb.clear_counters();
@@ -223,6 +235,10 @@ int main(int argc, char** argv) {
               << "\"compdists\":" << avgD << ","
               << "\"time_ms\":" << avgTms << ","
               << "\"pages\":" << avgPg << ","
+              << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+              << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+              << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+              << "\"hit_rate\":" << pool.get_hitRate() << ","
               << "\"n_queries\":" << queries.size() << ","
               << "\"run_id\":1"
               << "}";
@@ -237,6 +253,7 @@ int main(int argc, char** argv) {
             long long totalD = 0;
             long long totalT = 0;
             long long totalP = 0;
+            pool.reset_stats();
 
             for (int q : queries) {
                 spb.clear_counters();
@@ -275,6 +292,10 @@ int main(int argc, char** argv) {
               << "\"compdists\":" << avgD << ","
               << "\"time_ms\":" << avgTms << ","
               << "\"pages\":" << avgPg << ","
+              << "\"pool_pages\":" << BUFFER_POOL_PAGES << ","
+              << "\"pool_hits\":" << double(pool.get_hits()) / queries.size() << ","
+              << "\"pool_misses\":" << double(pool.get_misses()) / queries.size() << ","
+              << "\"hit_rate\":" << pool.get_hitRate() << ","
               << "\"n_queries\":" << queries.size() << ","
               << "\"run_id\":1"
               << "}";
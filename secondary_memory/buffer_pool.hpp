@@ -0,0 +1,283 @@
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+
+#include <unistd.h>
+
+// ============================================================
+// BufferPool: caché de páginas compartido por los índices en
+// memoria secundaria (M-tree, EGNAT, LC, MB+-tree y los RAF).
+//
+//  • Cachea páginas de pageSize bytes de cualquier archivo abierto;
+//    la clave es (fd, nº de página).
+//  • Reemplazo LRU o CLOCK sobre un presupuesto fijo de páginas.
+//  • Las páginas fijadas (pin) no se desalojan: se usan para mantener
+//    en RAM los niveles superiores de los árboles.
+//    Como máximo se fija la mitad del presupuesto.
+//  • capacity = 0 desactiva el caché: todo acceso es un fallo y se lee
+//    directamente con pread.
+//
+// Los índices siguen contando pageReads como accesos lógicos (métrica
+// del paper); hits / misses miden cuántos de esos accesos llegaron
+// realmente al kernel.
+// ============================================================
+class BufferPool {
+public:
+    enum class Policy { LRU, CLOCK };
+
+    explicit BufferPool(size_t capacityPages = 256,
+                        size_t pageSize_ = 4096,
+                        Policy policy_ = Policy::LRU)
+        : capacity(capacityPages),
+          pageSize(std::max<size_t>(512, pageSize_)),
+          policy(policy_),
+          data(capacityPages * std::max<size_t>(512, pageSize_)),
+          frames(capacityPages),
+          scratch(std::max<size_t>(512, pageSize_))
+    {
+        clear();
+    }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Copia [offset, offset+len) de fd en dst, página a página a través del pool
+    void read(int fd, int64_t offset, size_t len, void* dst) {
+        char* out = static_cast<char*>(dst);
+        while (len > 0) {
+            int64_t page  = offset / (int64_t)pageSize;
+            size_t  inPage = (size_t)(offset - page * (int64_t)pageSize);
+            size_t  chunk  = std::min(len, pageSize - inPage);
+
+            const char* src = fetch(fd, page, true);
+            std::memcpy(out, src + inPage, chunk);
+
+            out    += chunk;
+            offset += (int64_t)chunk;
+            len    -= chunk;
+        }
+    }
+
+    // Escribe [offset, offset+len) en fd (write-through) y actualiza las
+    // páginas que ya estén residentes, para que el pool no sirva datos viejos
+    void write(int fd, int64_t offset, size_t len, const void* src) {
+        if (::pwrite(fd, src, len, (off_t)offset) != (ssize_t)len)
+            throw std::runtime_error("[BufferPool] pwrite falló");
+
+        const char* in = static_cast<const char*>(src);
+        while (len > 0) {
+            int64_t page  = offset / (int64_t)pageSize;
+            size_t  inPage = (size_t)(offset - page * (int64_t)pageSize);
+            size_t  chunk  = std::min(len, pageSize - inPage);
+
+            auto it = table.find(key(fd, page));
+            if (it != table.end())
+                std::memcpy(frameData(it->second) + inPage, in, chunk);
+
+            in     += chunk;
+            offset += (int64_t)chunk;
+            len    -= chunk;
+        }
+    }
+
+    // Carga y fija las páginas de [offset, offset+len). Devuelve false si
+    // se alcanzó el máximo de páginas fijadas (la mitad del presupuesto,
+    // para que el resto del pool siga sirviendo a las consultas).
+    bool pin(int fd, int64_t offset, size_t len) {
+        if (len == 0) return true;
+        int64_t first = offset / (int64_t)pageSize;
+        int64_t last  = (offset + (int64_t)len - 1) / (int64_t)pageSize;
+        for (int64_t p = first; p <= last; ++p) {
+            auto it = table.find(key(fd, p));
+            if (it != table.end() && frames[it->second].pinned) continue;
+            if (pinnedCount + 1 > capacity / 2) return false;
+
+            fetch(fd, p, false);
+            int f = table.at(key(fd, p));
+            Frame& fr = frames[f];
+            if (policy == Policy::LRU) lru.erase(fr.lruPos);
+            fr.pinned = true;
+            pinnedCount++;
+        }
+        return true;
+    }
+
+    void unpinAll() {
+        for (size_t f = 0; f < frames.size(); ++f) {
+            Frame& fr = frames[f];
+            if (!fr.valid || !fr.pinned) continue;
+            fr.pinned = false;
+            if (policy == Policy::LRU) {
+                lru.push_front((int)f);
+                fr.lruPos = lru.begin();
+            }
+        }
+        pinnedCount = 0;
+    }
+
+    // Descarta las páginas de un archivo (antes de cerrarlo o reescribirlo)
+    void invalidate(int fd) {
+        for (size_t f = 0; f < frames.size(); ++f) {
+            Frame& fr = frames[f];
+            if (!fr.valid || fr.fd != fd) continue;
+            release((int)f);
+        }
+    }
+
+    // Vacía el pool (caché frío) y reinicia estadísticas
+    void clear() {
+        table.clear();
+        lru.clear();
+        freeFrames.clear();
+        for (size_t f = frames.size(); f-- > 0; ) {
+            frames[f] = Frame();
+            freeFrames.push_back((int)f);
+        }
+        hand = 0;
+        pinnedCount = 0;
+        reset_stats();
+    }
+
+    void reset_stats() { hits = 0; misses = 0; }
+
+    long long get_hits()     const { return hits;   }
+    long long get_misses()   const { return misses; }
+    double    get_hitRate()  const {
+        long long total = hits + misses;
+        return total ? (double)hits / (double)total : 0.0;
+    }
+    size_t get_capacity()    const { return capacity;    }
+    size_t get_pageSize()    const { return pageSize;    }
+    size_t get_pinned()      const { return pinnedCount; }
+    const char* policyName() const { return policy == Policy::LRU ? "LRU" : "CLOCK"; }
+
+private:
+    struct Frame {
+        int     fd     = -1;
+        int64_t page   = -1;
+        bool    valid  = false;
+        bool    pinned = false;
+        bool    ref    = false;          // bit de referencia (CLOCK)
+        std::list<int>::iterator lruPos; // posición en 'lru' (LRU, no fijadas)
+    };
+
+    size_t capacity;
+    size_t pageSize;
+    Policy policy;
+
+    std::vector<char>  data;       // capacity * pageSize bytes
+    std::vector<Frame> frames;
+    std::unordered_map<uint64_t, int> table;
+    std::list<int>     lru;        // frente = más reciente
+    std::vector<int>   freeFrames;
+    std::vector<char>  scratch;    // lectura directa cuando no hay frame
+    size_t hand = 0;
+    size_t pinnedCount = 0;
+
+    long long hits   = 0;
+    long long misses = 0;
+
+    static uint64_t key(int fd, int64_t page) {
+        return ((uint64_t)(uint32_t)fd << 40) | (uint64_t)page;
+    }
+
+    char* frameData(int f) { return data.data() + (size_t)f * pageSize; }
+
+    void load(int fd, int64_t page, char* buf) {
+        ssize_t r = ::pread(fd, buf, pageSize, (off_t)(page * (int64_t)pageSize));
+        if (r < 0)
+            throw std::runtime_error("[BufferPool] pread falló");
+        if ((size_t)r < pageSize)
+            std::memset(buf + r, 0, pageSize - (size_t)r); // última página del archivo
+    }
+
+    // Devuelve la página (fd, page); la lee del disco si no está residente
+    const char* fetch(int fd, int64_t page, bool count) {
+        auto it = table.find(key(fd, page));
+        if (it != table.end()) {
+            if (count) hits++;
+            touch(it->second);
+            return frameData(it->second);
+        }
+
+        if (count) misses++;
+
+        int f = victim();
+        if (f < 0) {
+            load(fd, page, scratch.data());
+            return scratch.data();
+        }
+
+        load(fd, page, frameData(f));
+        Frame& fr = frames[f];
+        fr.fd     = fd;
+        fr.page   = page;
+        fr.valid  = true;
+        fr.pinned = false;
+        fr.ref    = true;
+        if (policy == Policy::LRU) {
+            lru.push_front(f);
+            fr.lruPos = lru.begin();
+        }
+        table[key(fd, page)] = f;
+        return frameData(f);
+    }
+
+    void touch(int f) {
+        Frame& fr = frames[f];
+        if (policy == Policy::CLOCK) {
+            fr.ref = true;
+        } else if (!fr.pinned) {
+            lru.splice(lru.begin(), lru, fr.lruPos);
+        }
+    }
+
+    void release(int f) {
+        Frame& fr = frames[f];
+        table.erase(key(fr.fd, fr.page));
+        if (fr.pinned) pinnedCount--;
+        else if (policy == Policy::LRU) lru.erase(fr.lruPos);
+        fr = Frame();
+        freeFrames.push_back(f);
+    }
+
+    // Frame libre o víctima según la política; -1 si no hay ninguno
+    int victim() {
+        if (capacity == 0) return -1;
+        if (!freeFrames.empty()) {
+            int f = freeFrames.back();
+            freeFrames.pop_back();
+            return f;
+        }
+
+        int f = -1;
+        if (policy == Policy::LRU) {
+            if (lru.empty()) return -1;
+            f = lru.back();
+        } else {
+            for (size_t step = 0; step < 2 * capacity; ++step) {
+                Frame& fr = frames[hand];
+                size_t cur = hand;
+                hand = (hand + 1) % capacity;
+                if (fr.pinned) continue;
+                if (fr.ref) { fr.ref = false; continue; }
+                f = (int)cur;
+                break;
+            }
+            if (f < 0) return -1;
+        }
+
+        release(f);
+        freeFrames.pop_back();
+        return f;
+    }
+};
+
+#endif // BUFFER_POOL_HPP
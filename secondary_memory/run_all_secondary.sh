@@ -50,7 +50,7 @@ for struct in "${STRUCTURES[@]}"; do
   cd "${SCRIPT_DIR}/${struct}"
 
   echo "[1/3] Compiling..."
-  g++ -O3 -std=c++17 test.cpp -o "${struct}_test"
+  g++ -O3 -std=c++17 -pthread test.cpp -o "${struct}_test"
   compile_exit=$?
 
   if [ "$compile_exit" -ne 0 ]; then